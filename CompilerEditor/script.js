@@ -73,11 +73,16 @@ function handleCompile() {
   }
 
   try {
-    const result = Module.processFileContent(code);
+    const result = Module.processFileContent(code, true);
     const parsedResult = JSON.parse(result);
 
     if (!parsedResult.success) {
-      throw new Error(parsedResult.error);
+      const errors = parsedResult.errors || [];
+      throw new Error(
+        errors.length > 1
+          ? errors.map((e) => `${e.location}: ${e.message}`).join("\n")
+          : parsedResult.error
+      );
     }
 
     displayResults(parsedResult);
@@ -0,0 +1,104 @@
+// Arena.hpp
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////
+/// Bump allocator for objects that all die together. Memory is carved out
+/// of large blocks; nothing is freed individually and no destructors run,
+/// so only trivially destructible types may be placed in it. reset()
+/// rewinds to the first block and keeps every block for reuse, so a
+/// long-lived arena stops allocating once it has seen its largest input.
+///////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+class Arena
+{
+  public:
+    explicit Arena(size_t blockSize = 64 * 1024) : m_blockSize(blockSize) {}
+
+    Arena(const Arena&)            = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* allocate(size_t size, size_t align)
+    {
+        while (true)
+        {
+            if (m_current < m_blocks.size())
+            {
+                auto&        block   = m_blocks[m_current];
+                const size_t aligned = (m_used + align - 1) & ~(align - 1);
+                if (aligned + size <= block.size)
+                {
+                    m_used = aligned + size;
+                    return block.data.get() + aligned;
+                }
+                if (m_current + 1 < m_blocks.size())
+                {
+                    ++m_current;
+                    m_used = 0;
+                    continue;
+                }
+            }
+            m_blocks.push_back(Block::make(std::max(m_blockSize, size + align)));
+            m_current = m_blocks.size() - 1;
+            m_used    = 0;
+        }
+    }
+
+    template <typename T, typename... Args> T* create(Args&&... args)
+    {
+        static_assert(std::is_trivially_destructible_v<T>, "arena objects are never destroyed");
+        ++m_objects;
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    //! Copies `items` into the arena and returns a view of the copy
+    template <typename T> std::span<T> copy(std::span<const T> items)
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "arena arrays are copied bytewise");
+        if (items.empty())
+            return {};
+        auto* data = static_cast<T*>(allocate(items.size_bytes(), alignof(T)));
+        std::memcpy(data, items.data(), items.size_bytes());
+        return {data, items.size()};
+    }
+
+    //! Releases every object at once; the blocks are kept for the next use
+    void reset()
+    {
+        m_current = 0;
+        m_used    = 0;
+        m_objects = 0;
+        ++m_resets;
+    }
+
+    size_t blockCount() const { return m_blocks.size(); }
+    //! Objects made with create() since the last reset
+    size_t objectCount() const { return m_objects; }
+    //! How often the arena was reset, so that whoever keeps pointers into it can tell they went stale
+    size_t resetCount() const { return m_resets; }
+
+  private:
+    struct Block
+    {
+        std::unique_ptr<std::byte[]> data;
+        size_t                       size = 0;
+
+        static Block make(size_t size) { return {std::make_unique_for_overwrite<std::byte[]>(size), size}; }
+    };
+
+    std::vector<Block> m_blocks;
+    size_t             m_blockSize;
+    size_t             m_current = 0;
+    size_t             m_used    = 0;
+    size_t             m_objects = 0;
+    size_t             m_resets  = 0;
+};
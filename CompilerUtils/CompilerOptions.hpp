@@ -0,0 +1,45 @@
+// CompilerOptions.hpp
+#pragma once
+
+#include <cstddef>
+
+class ThreadPool;
+
+//! Default for CompilerOptions::maxNestingDepth
+inline constexpr size_t defaultMaxNestingDepth = 256;
+//! Default for CompilerOptions::maxErrors
+inline constexpr size_t defaultMaxErrors = 20;
+
+//! Switches that select which sections a compilation writes to CompilerOutput
+struct CompilerOptions
+{
+    //! Emit the "Lexer" token dump; turning it off skips all per-token JSON work
+    bool emitLexer = true;
+    //! Emit the "AST" section. Tools that read Compiler::binaryAST() instead can turn it off.
+    bool emitAST = true;
+    //! Keep the program's flat AST for Compiler::binaryAST() even with emitAST off. With both off the
+    //! compiler builds no flat AST at all.
+    bool emitBinaryAST = false;
+    //! Deepest nesting of parentheses and blocks the parser accepts; deeper input is a syntax error
+    //! rather than a stack overflow
+    size_t maxNestingDepth = defaultMaxNestingDepth;
+    //! Compilation stops after this many errors; at least one is always reported
+    size_t maxErrors = defaultMaxErrors;
+    //! Parse, analyze and generate on three threads, each stage handing finished top-level statements
+    //! to the next. The output is the same as when compiling on one thread.
+    bool pipelined = false;
+    //! Build identical pure subtrees (literals, variables and arithmetic over them) of a statement as one
+    //! node, and infer their type once. While the AST is kept for output, each occurrence keeps a node
+    //! at its own position instead, and the program's flat AST stores the subtree once. The output is
+    //! the same as without sharing.
+    bool shareSubtrees = false;
+    //! Generate each statement in the same walk that analyzes it, rather than in a second walk once it
+    //! has been analyzed. The output and errors are the same either way.
+    bool fuseCodegen = false;
+    //! Compute constant expressions, and reads of variables known to hold a constant, at compile time
+    //! (ConstantFolder). The generated code differs; errors do not.
+    bool foldConstants = false;
+    //! Pool to lex sources of Lexer::parallelThreshold bytes or more on; without one, the source is
+    //! lexed on the calling thread
+    ThreadPool* lexerPool = nullptr;
+};
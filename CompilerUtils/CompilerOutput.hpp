@@ -1,10 +1,14 @@
 // CompilerOutput.hpp
 #pragma once
 
+#include "Error.hpp"
+#include <algorithm>
 #include <fstream>
+#include <iterator>
 #include <nlohmann/json.hpp>
 #include <sstream>
 #include <string>
+#include <vector>
 
 class CompilerOutput
 {
@@ -24,10 +28,29 @@ class CompilerOutput
 
     nlohmann::json& getError() { return m_json["error"]; }
 
+    //! Appends `error` to the "errors" array. The first one is also kept as "error", which is all that
+    //! clients reading a single message look at.
+    void addError(const Error& error)
+    {
+        if (!m_json.contains("errors"))
+            setError(error.what());
+        m_json["errors"].push_back({{"type", getErrorTypeDescription(error.getType())},
+                                    {"message", error.getMessage()},
+                                    {"location", error.getLocation().toString()}});
+    }
+
+    //! The JSON text, formatted as nlohmann::json::dump(indent) would
+    std::string dump(int indent = -1) const
+    {
+        std::ostringstream out;
+        serialize(out, m_json, indent);
+        return out.str();
+    }
+
     void writeToFile(const std::string& filename) const
     {
         std::ofstream file(filename);
-        file << m_json.dump(4);
+        serialize(file, m_json, 4);
     }
 
     std::string readFromFile() const
@@ -35,7 +58,7 @@ class CompilerOutput
         std::ifstream inputFile(m_filename);
         if (!inputFile.is_open())
         {
-            throw std::runtime_error("Unable to open input file: " + m_filename);
+            fatalError("Unable to open input file: " + m_filename);
         }
         std::ostringstream sstr;
         sstr << inputFile.rdbuf();
@@ -43,6 +66,61 @@ class CompilerOutput
     }
 
   private:
+    // Same text as nlohmann's dump(), but built on an explicit stack: the AST section nests as
+    // deep as the longest expression, far deeper than the recursive serializer can go
+    static void serialize(std::ostream& out, const nlohmann::json& root, int indent)
+    {
+        struct Frame
+        {
+            const nlohmann::json*          value;
+            nlohmann::json::const_iterator next;
+        };
+
+        std::vector<Frame> stack;
+        auto               newline = [&](size_t depth)
+        {
+            if (indent < 0)
+                return;
+            out << '\n';
+            std::fill_n(std::ostreambuf_iterator<char>(out), depth * static_cast<size_t>(indent), ' ');
+        };
+        auto open = [&](const nlohmann::json& value)
+        {
+            if (!value.is_structured() || value.empty())
+            {
+                out << value.dump(); // scalars, {} and []
+                return;
+            }
+            out << (value.is_object() ? '{' : '[');
+            stack.push_back({&value, value.cbegin()});
+        };
+
+        open(root);
+        while (!stack.empty())
+        {
+            const size_t depth = stack.size();
+            Frame&       frame = stack.back();
+            if (frame.next == frame.value->cend())
+            {
+                newline(depth - 1);
+                out << (frame.value->is_object() ? '}' : ']');
+                stack.pop_back();
+                continue;
+            }
+
+            if (frame.next != frame.value->cbegin())
+                out << ',';
+            newline(depth);
+            if (frame.value->is_object())
+            {
+                out << nlohmann::json(frame.next.key()).dump();
+                out << (indent < 0 ? ":" : ": ");
+            }
+            const nlohmann::json& child = *frame.next++;
+            open(child); // may push, so `frame` is not used past this point
+        }
+    }
+
     nlohmann::json m_json;
     std::string m_filename;
 };
\ No newline at end of file
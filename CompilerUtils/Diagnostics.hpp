@@ -0,0 +1,42 @@
+// Diagnostics.hpp
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "Error.hpp"
+
+//! Collects the errors of one compilation so that it can report them all instead of only the first.
+//! Recording stops at a cap, which keeps pathological inputs cheap.
+class Diagnostics
+{
+  public:
+    explicit Diagnostics(size_t maxErrors) : m_maxErrors(maxErrors) {}
+
+    //! Records `error`, which should already carry its location. Returns false, dropping the error,
+    //! once the cap is reached.
+    bool report(const Error& error)
+    {
+        if (full())
+            return false;
+        m_errors.push_back(error);
+        return true;
+    }
+
+    //! Forgets every recorded error
+    void                      clear() { m_errors.clear(); }
+    //! Forgets the errors recorded after the first `count`
+    void                      truncate(size_t count)
+    {
+        if (count < m_errors.size())
+            m_errors.erase(m_errors.begin() + static_cast<std::ptrdiff_t>(count), m_errors.end());
+    }
+    bool                      full() const { return m_errors.size() >= m_maxErrors; }
+    bool                      empty() const { return m_errors.empty(); }
+    size_t                    size() const { return m_errors.size(); }
+    const std::vector<Error>& errors() const { return m_errors; }
+
+  private:
+    size_t             m_maxErrors;
+    std::vector<Error> m_errors;
+};
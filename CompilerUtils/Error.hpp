@@ -1,5 +1,9 @@
 #pragma once
 #include "SourceLocation.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
 #include <string>
 #include <string_view>
 #include <utility>
@@ -30,12 +34,12 @@ class Error : public std::exception
 {
   public:
     explicit Error(std::string message = "An unknown error occurred.")
-        : m_message(std::move(message)), m_type(ErrorType::SYNTAX), m_location()
+        : m_message(std::move(message)), m_type(ErrorType::SYNTAX), m_offset(noSourceOffset)
     {
     }
 
-    Error(std::string message, const SourceLocation& location, ErrorType type = ErrorType::SYNTAX)
-        : m_message(std::move(message)), m_type(type), m_location(location)
+    Error(std::string message, std::uint32_t offset, ErrorType type = ErrorType::SYNTAX)
+        : m_message(std::move(message)), m_type(type), m_offset(offset)
     {
     }
 
@@ -51,11 +55,32 @@ class Error : public std::exception
 
     ErrorType getType() const noexcept { return m_type; }
     const SourceLocation& getLocation() const noexcept { return m_location; }
+    std::uint32_t getOffset() const noexcept { return m_offset; }
     const std::string& getMessage() const noexcept { return m_message; }
 
+    //! Attaches the line/column resolved from the error's offset
+    void setLocation(const SourceLocation& location)
+    {
+        m_location = location;
+        m_fullMessage.clear();
+    }
+
   private:
     std::string m_message;
     ErrorType m_type;
+    std::uint32_t m_offset;
     SourceLocation m_location;
     mutable std::string m_fullMessage; 
 };
+
+//! Fails on a problem with the environment, such as I/O, rather than with the source: throws
+//! std::runtime_error, or prints `message` and aborts in builds without exceptions (NO_EXCEPTIONS)
+[[noreturn]] inline void fatalError(const std::string& message)
+{
+#if defined(CURIOUSX_NO_EXCEPTIONS)
+    std::fprintf(stderr, "%s\n", message.c_str());
+    std::abort();
+#else
+    throw std::runtime_error(message);
+#endif
+}
@@ -0,0 +1,103 @@
+// Expected.hpp
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////
+/// Result type for the exception-free entry points of the compiler phases:
+/// either a value or the Error that prevented it. This is std::expected
+/// where the standard library has it (C++23) and a minimal polyfill with
+/// the same interface otherwise, so callers can be written against
+/// std::expected today. The polyfill leaves out value(), whose
+/// bad_expected_access it could not match; test the result and use
+/// operator* instead.
+///
+///   Expected<ASTNode*> node = parser.tryParseStatement(token);
+///   if (!node)
+///       return Unexpected(node.error());
+///////////////////////////////////////////////////////////////////////////
+
+#include <version>
+
+#include "Error.hpp"
+
+#if defined(__cpp_lib_expected)
+
+#include <expected>
+
+template <typename T, typename E = Error>
+using Expected = std::expected<T, E>;
+template <typename E>
+using Unexpected = std::unexpected<E>;
+
+#else
+
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+template <typename E>
+class Unexpected
+{
+  public:
+    explicit Unexpected(E error) : m_error(std::move(error)) {}
+
+    const E& error() const& noexcept { return m_error; }
+    E&&      error() && noexcept { return std::move(m_error); }
+
+  private:
+    E m_error;
+};
+
+template <typename E>
+Unexpected(E) -> Unexpected<E>;
+
+template <typename T, typename E = Error>
+class Expected
+{
+  public:
+    template <typename U = T>
+        requires std::is_constructible_v<T, U&&>
+    Expected(U&& value) : m_storage(std::in_place_index<0>, std::forward<U>(value))
+    {
+    }
+    template <typename G>
+    Expected(Unexpected<G> error) : m_storage(std::in_place_index<1>, std::move(error).error())
+    {
+    }
+
+    bool     has_value() const noexcept { return m_storage.index() == 0; }
+    explicit operator bool() const noexcept { return has_value(); }
+
+    T&       operator*() & noexcept { return *std::get_if<0>(&m_storage); }
+    const T& operator*() const& noexcept { return *std::get_if<0>(&m_storage); }
+    T*       operator->() noexcept { return std::get_if<0>(&m_storage); }
+    const T* operator->() const noexcept { return std::get_if<0>(&m_storage); }
+
+    E&       error() & noexcept { return *std::get_if<1>(&m_storage); }
+    const E& error() const& noexcept { return *std::get_if<1>(&m_storage); }
+
+  private:
+    std::variant<T, E> m_storage;
+};
+
+template <typename E>
+class Expected<void, E>
+{
+  public:
+    Expected() = default;
+    template <typename G>
+    Expected(Unexpected<G> error) : m_error(std::move(error).error())
+    {
+    }
+
+    bool     has_value() const noexcept { return !m_error; }
+    explicit operator bool() const noexcept { return has_value(); }
+
+    E&       error() & noexcept { return *m_error; }
+    const E& error() const& noexcept { return *m_error; }
+
+  private:
+    std::optional<E> m_error;
+};
+
+#endif
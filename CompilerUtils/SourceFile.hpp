@@ -0,0 +1,118 @@
+// SourceFile.hpp
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////
+/// Read-only view of an input file. Regular files are memory-mapped so the
+/// lexer's string_views point straight into the page cache without copying;
+/// pipes, character devices and platforms without mmap fall back to reading
+/// the whole stream into an owned buffer.
+///////////////////////////////////////////////////////////////////////////
+
+#include "Error.hpp"
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <string_view>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define CURIOUSX_HAS_MMAP 1
+#else
+#include <fstream>
+#include <sstream>
+#endif
+
+class SourceFile
+{
+  public:
+    //! Opens `filename`; "-" reads standard input
+    explicit SourceFile(const std::string& filename)
+    {
+#if defined(CURIOUSX_HAS_MMAP)
+        const bool useStdin = filename == "-";
+        const int  fd       = useStdin ? STDIN_FILENO : ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0)
+            fatalError("Unable to open input file: " + filename);
+
+        struct stat info{};
+        if (::fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0)
+        {
+            m_size    = static_cast<size_t>(info.st_size);
+            void* map = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (map != MAP_FAILED)
+            {
+                ::madvise(map, m_size, MADV_SEQUENTIAL);
+                m_data = static_cast<const char*>(map);
+            }
+        }
+        if (!m_data)
+            readAll(fd);
+        if (!useStdin)
+            ::close(fd);
+#else
+        std::ifstream inputFile(filename, std::ios::binary);
+        if (!inputFile.is_open())
+            fatalError("Unable to open input file: " + filename);
+        std::ostringstream sstr;
+        sstr << inputFile.rdbuf();
+        m_buffer = sstr.str();
+        m_data   = m_buffer.data();
+        m_size   = m_buffer.size();
+#endif
+        // Token offsets are 32-bit
+        if (m_size >= std::numeric_limits<std::uint32_t>::max())
+        {
+            release();
+            fatalError("Input file is too large (4 GiB limit): " + filename);
+        }
+    }
+
+    SourceFile(const SourceFile&)            = delete;
+    SourceFile& operator=(const SourceFile&) = delete;
+
+    ~SourceFile() { release(); }
+
+    std::string_view view() const { return {m_data ? m_data : "", m_size}; }
+    bool             isMapped() const { return m_data && m_data != m_buffer.data(); }
+
+  private:
+#if defined(CURIOUSX_HAS_MMAP)
+    void readAll(int fd)
+    {
+        char buffer[1 << 16];
+        while (true)
+        {
+            const auto count = ::read(fd, buffer, sizeof(buffer));
+            if (count == 0)
+                break;
+            if (count < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                fatalError("Unable to read input file");
+            }
+            m_buffer.append(buffer, static_cast<size_t>(count));
+        }
+        m_data = m_buffer.data();
+        m_size = m_buffer.size();
+    }
+#endif
+
+    void release()
+    {
+#if defined(CURIOUSX_HAS_MMAP)
+        if (isMapped())
+            ::munmap(const_cast<char*>(m_data), m_size);
+#endif
+        m_data = nullptr;
+        m_size = 0;
+    }
+
+    const char* m_data = nullptr;
+    size_t      m_size = 0;
+    std::string m_buffer;
+};
@@ -22,27 +22,34 @@
 ///////////////////////////////////////////////////////////////////////////
 /// This file contains implementation of the helper logic for tracking source locations
 /// as it is useful for the parser or typechecker to know exactly what line
-/// and column number a token was located at
+/// and column number a token was located at.
+/// Tokens only carry a byte offset; a line and column are resolved from it
+/// on demand (see LineIndex) when an error or JSON output needs one.
 ///////////////////////////////////////////////////////////////////////////
 
+#include <cstdint>
 #include <format>
+#include <limits>
 #include <string>
 
+//! Offset of tokens and errors that do not correspond to a position in the source
+inline constexpr std::uint32_t noSourceOffset = std::numeric_limits<std::uint32_t>::max();
+
 class SourceLocation
 {
   public:
     SourceLocation() = default;
-    SourceLocation(unsigned short _line, unsigned short _col) : line(_line), col(_col) {}
+    SourceLocation(std::uint32_t _line, std::uint32_t _col) : line(_line), col(_col) {}
 
-    unsigned short getLine() const { return line; }
+    std::uint32_t getLine() const { return line; }
 
-    unsigned short getCol() const { return col; }
+    std::uint32_t getCol() const { return col; }
 
     std::string toString() const { return std::format("<line:{}, col:{}>", line, col); }
 
   private:
-    unsigned short line = 0;
-    unsigned short col = 0;
+    std::uint32_t line = 0;
+    std::uint32_t col = 0;
 };
 
 //! Represents the start and stop locations for a token, symbol, or expression
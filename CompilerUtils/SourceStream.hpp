@@ -0,0 +1,205 @@
+// SourceStream.hpp
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////
+/// Incremental reader that hands out the source one top-level statement at
+/// a time, for inputs that should not be held in memory as a whole (pipes,
+/// stdin). Bytes are read from a file descriptor into a refillable buffer;
+/// when a statement does not fit, the consumed prefix is compacted away and
+/// the buffer only grows if a single statement is larger than its capacity.
+///
+/// A statement ends at a newline outside of `{ }` unless the next line
+/// starting with real code continues it (`{` or `else`). Blank and comment
+/// lines travel with the statement before them, so every chunk parses on its
+/// own exactly as it would as part of the whole file.
+///////////////////////////////////////////////////////////////////////////
+
+#include "Error.hpp"
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#if defined(_WIN32)
+#include <cstdio>
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <cerrno>
+#include <unistd.h>
+#endif
+
+class SourceStream
+{
+  public:
+    explicit SourceStream(int fd, size_t capacity = 64 * 1024) : m_fd(fd), m_buffer(capacity) {}
+
+    //! Reads standard input. On Windows it is switched to binary mode first, so that CRLF line ends
+    //! reach the lexer untranslated and token offsets match the bytes of the input.
+    static SourceStream standardInput()
+    {
+#if defined(_WIN32)
+        const int fd = _fileno(stdin);
+        _setmode(fd, _O_BINARY);
+        return SourceStream(fd);
+#else
+        return SourceStream(STDIN_FILENO);
+#endif
+    }
+
+    //! Returns the next chunk of complete statements. The view stays valid until the next call.
+    std::optional<std::string_view> nextStatement()
+    {
+        for (size_t i = m_begin; i < m_chunkEnd; ++i)
+            m_nextLine += m_buffer[i] == '\n';
+        m_begin     = m_chunkEnd;
+        m_firstLine = m_nextLine;
+
+        size_t line         = m_begin; // start of the line being examined
+        int    depth        = 0;
+        bool   sawStatement = false;
+        while (true)
+        {
+            size_t lineEnd = findLineEnd(line);
+            if (lineEnd == m_end && !m_eof)
+            {
+                const size_t consumed = line - m_begin;
+                refill();
+                line    = m_begin + consumed;
+                continue;
+            }
+            if (line == m_end)
+                break;
+
+            if (depth == 0 && sawStatement && startsStatement(line, lineEnd))
+                break;
+
+            sawStatement |= scanLine(line, lineEnd, depth);
+            line = lineEnd == m_end ? m_end : lineEnd + 1;
+        }
+
+        m_chunkEnd = line;
+        if (m_chunkEnd == m_begin)
+            return std::nullopt;
+        return std::string_view(m_buffer.data() + m_begin, m_chunkEnd - m_begin);
+    }
+
+    //! Line number of the first line in the chunk last returned by nextStatement()
+    std::uint32_t firstLine() const { return m_firstLine; }
+
+    //! Bytes currently reserved for buffering; bounded by the largest statement
+    size_t capacity() const { return m_buffer.size(); }
+
+  private:
+    // Position of the '\n' ending the line at `from`, or m_end if it is not buffered yet
+    size_t findLineEnd(size_t from) const
+    {
+        const void* nl = std::memchr(m_buffer.data() + from, '\n', m_end - from);
+        return nl ? static_cast<size_t>(static_cast<const char*>(nl) - m_buffer.data()) : m_end;
+    }
+
+    // Whether the line holds code that begins a new statement rather than continuing the current one
+    bool startsStatement(size_t from, size_t to) const
+    {
+        while (from < to && (m_buffer[from] == ' ' || m_buffer[from] == '\t'))
+            ++from;
+        if (from == to || m_buffer[from] == '#' || m_buffer[from] == '{')
+            return false;
+
+        // `else` continues an if statement, unless it is only the prefix of an identifier
+        const std::string_view rest(m_buffer.data() + from, to - from);
+        if (!rest.starts_with("else"))
+            return true;
+        return rest.size() > 4 && (std::isalnum(static_cast<unsigned char>(rest[4])) || rest[4] == '.');
+    }
+
+    // Tracks brace depth over one line, skipping strings and comments; returns true if the line has code
+    bool scanLine(size_t from, size_t to, int& depth) const
+    {
+        bool hasCode = false;
+        for (size_t i = from; i < to; ++i)
+        {
+            const char c = m_buffer[i];
+            if (c == '#')
+                break;
+            if (c == ' ' || c == '\t')
+                continue;
+
+            hasCode = true;
+            if (c == '"')
+            {
+                // Strings cannot span lines; an unclosed one is reported by the lexer
+                while (++i < to && m_buffer[i] != '"')
+                {
+                }
+            }
+            else if (c == '{')
+            {
+                ++depth;
+            }
+            else if (c == '}' && depth > 0)
+            {
+                --depth;
+            }
+        }
+        return hasCode;
+    }
+
+    // Moves unconsumed bytes to the front, grows the buffer if it is full, then reads more
+    void refill()
+    {
+        if (m_begin > 0)
+        {
+            std::memmove(m_buffer.data(), m_buffer.data() + m_begin, m_end - m_begin);
+            m_end -= m_begin;
+            m_chunkEnd -= m_begin;
+            m_begin = 0;
+        }
+        if (m_end == m_buffer.size())
+            m_buffer.resize(m_buffer.size() * 2);
+
+        const auto count = readSome(m_buffer.data() + m_end, m_buffer.size() - m_end);
+        if (count == 0)
+        {
+            m_eof = true;
+            return;
+        }
+
+        // A NUL byte ends the program, as it does for the whole-file lexer
+        if (const void* nul = std::memchr(m_buffer.data() + m_end, '\0', count))
+        {
+            m_end = static_cast<size_t>(static_cast<const char*>(nul) - m_buffer.data());
+            m_eof = true;
+            return;
+        }
+        m_end += count;
+    }
+
+    size_t readSome(char* into, size_t size)
+    {
+        while (true)
+        {
+#if defined(_WIN32)
+            const auto count = ::_read(m_fd, into, static_cast<unsigned>(size));
+#else
+            const auto count = ::read(m_fd, into, size);
+            if (count < 0 && errno == EINTR)
+                continue;
+#endif
+            if (count < 0)
+                fatalError("Unable to read input stream");
+            return static_cast<size_t>(count);
+        }
+    }
+
+    int               m_fd;
+    std::vector<char> m_buffer;
+    size_t            m_begin     = 0; // start of the current chunk
+    size_t            m_chunkEnd  = 0; // end of the current chunk
+    size_t            m_end       = 0; // end of buffered data
+    bool              m_eof       = false;
+    std::uint32_t     m_firstLine = 1;
+    std::uint32_t     m_nextLine  = 1;
+};
@@ -0,0 +1,67 @@
+// SpscQueue.hpp
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////
+/// Bounded lock-free queue between exactly one producer thread and one
+/// consumer thread. The ring's head is only written by the consumer and
+/// its tail only by the producer, so neither side takes a lock; a side
+/// that finds the ring full or empty sleeps on the other side's index
+/// (std::atomic::wait) instead of spinning.
+///////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+template <typename T>
+class SpscQueue
+{
+  public:
+    //! Holds at least `capacity` elements; the ring is rounded up to a power of two
+    explicit SpscQueue(size_t capacity)
+        : m_slots(std::bit_ceil(std::max<size_t>(capacity, 1))), m_mask(m_slots.size() - 1)
+    {
+    }
+
+    SpscQueue(const SpscQueue&)            = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    //! Producer side: appends `value`, waiting while the ring is full
+    void push(T value)
+    {
+        const size_t tail = m_tail.load(std::memory_order_relaxed);
+        for (size_t head = m_head.load(std::memory_order_acquire); tail - head == m_slots.size();
+             head        = m_head.load(std::memory_order_acquire))
+            m_head.wait(head, std::memory_order_acquire);
+
+        m_slots[tail & m_mask] = std::move(value);
+        m_tail.store(tail + 1, std::memory_order_release);
+        m_tail.notify_one();
+    }
+
+    //! Consumer side: removes the oldest element, waiting while the ring is empty
+    T pop()
+    {
+        const size_t head = m_head.load(std::memory_order_relaxed);
+        for (size_t tail = m_tail.load(std::memory_order_acquire); tail == head;
+             tail        = m_tail.load(std::memory_order_acquire))
+            m_tail.wait(tail, std::memory_order_acquire);
+
+        T value = std::move(m_slots[head & m_mask]);
+        m_head.store(head + 1, std::memory_order_release);
+        m_head.notify_one();
+        return value;
+    }
+
+    size_t capacity() const { return m_slots.size(); }
+
+  private:
+    std::vector<T> m_slots;
+    size_t         m_mask;
+    // Each index on its own cache line, so the two threads do not contend for one
+    alignas(64) std::atomic<size_t> m_head{0}; // next slot to pop; written by the consumer
+    alignas(64) std::atomic<size_t> m_tail{0}; // next slot to push; written by the producer
+};
@@ -0,0 +1,96 @@
+// ThreadPool.hpp
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////
+/// Fixed-size pool of worker threads fed from a single FIFO queue. Tasks
+/// are submitted as callables and their results collected via futures;
+/// the destructor drains the queue before joining the workers.
+///////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+class ThreadPool
+{
+  public:
+    explicit ThreadPool(size_t threads = std::max(1u, std::thread::hardware_concurrency()))
+    {
+        m_workers.reserve(threads);
+        for (size_t i = 0; i < threads; ++i)
+            m_workers.emplace_back([this] { run(); });
+    }
+
+    ThreadPool(const ThreadPool&)            = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard lock(m_mutex);
+            m_stopping = true;
+        }
+        m_ready.notify_all();
+        for (auto& worker : m_workers)
+            worker.join();
+    }
+
+    //! Process-wide pool sized to the machine, created on first use
+    static ThreadPool& shared()
+    {
+        static ThreadPool pool;
+        return pool;
+    }
+
+    size_t size() const { return m_workers.size(); }
+
+    //! Whether the calling thread is one of this pool's workers. A task that waited on other tasks of
+    //! its own pool could deadlock it, so such work should run inline instead.
+    bool onWorkerThread() const { return t_current == this; }
+
+    template <typename F> std::future<std::invoke_result_t<F>> submit(F task)
+    {
+        auto packaged = std::make_shared<std::packaged_task<std::invoke_result_t<F>()>>(std::move(task));
+        auto result   = packaged->get_future();
+        {
+            std::lock_guard lock(m_mutex);
+            m_tasks.emplace([packaged] { (*packaged)(); });
+        }
+        m_ready.notify_one();
+        return result;
+    }
+
+  private:
+    void run()
+    {
+        t_current = this;
+        while (true)
+        {
+            std::function<void()> task;
+            {
+                std::unique_lock lock(m_mutex);
+                m_ready.wait(lock, [this] { return m_stopping || !m_tasks.empty(); });
+                if (m_tasks.empty())
+                    return;
+                task = std::move(m_tasks.front());
+                m_tasks.pop();
+            }
+            task();
+        }
+    }
+
+    std::vector<std::thread>          m_workers;
+    std::queue<std::function<void()>> m_tasks;
+    std::mutex                        m_mutex;
+    std::condition_variable           m_ready;
+    bool                              m_stopping = false;
+
+    static inline thread_local const ThreadPool* t_current = nullptr; // pool the thread works for
+};
@@ -1,54 +1,442 @@
 // Compiler.cpp
 #include "Compiler.hpp"
+#include <algorithm>
 
-Compiler::Compiler(std::string_view source, CompilerOutput& output)
-    : m_parser(source, output)
-    , m_semantic(output)
-    , m_codegen(output)
-    , m_root(ASTNodeFactory::createTreeNode({}, {"Program", {0, 0}, LexerTokenType::ProgramToken}))
+#if !defined(__EMSCRIPTEN__)
+#include "SpscQueue.hpp"
+#include <atomic>
+#include <optional>
+#include <thread>
+#endif
+
+namespace
+{
+LexerToken programToken()
+{
+    return {"Program", noSourceOffset, LexerTokenType::ProgramToken};
+}
+} // namespace
+
+Compiler::Compiler(std::string_view source, CompilerOutput& output, CompilerOptions options)
+    : m_diagnostics(std::max<size_t>(options.maxErrors, 1))
+    , m_parser(source,
+               output,
+               m_arena,
+               options.maxNestingDepth,
+               &m_diagnostics,
+               options.shareSubtrees,
+               options.lexerPool)
+    , m_semantic(output, m_symbols)
+    , m_codegen(output, m_symbols)
+    , m_folder(m_codegen, m_symbols)
+    , m_ast(m_parser.tokens(), options.shareSubtrees)
     , m_output(output)
+    , m_options(options)
+    , m_keepAST(options.emitAST || options.emitBinaryAST)
 {
+    m_parser.useIdentifiers(m_symbols.identifiers());
+    // The AST gives every occurrence its own position, so while it is kept only the hashes are shared
+    m_parser.shareNodes(!m_keepAST);
 }
 
+Compiler::Compiler(CompilerOutput& output, CompilerOptions options) : Compiler({}, output, options) {}
+
 bool Compiler::compile()
 {
-    try
+    LexerToken token = programToken();
+    m_parser.advanceToken(token);
+    if (!m_options.pipelined || compilePipelined(token))
+        compileStatements(token);
+    return finish();
+}
+
+bool Compiler::compile(SourceStream& stream)
+{
+    // Tokens only live as long as their chunk, so its part of the Lexer and AST sections is written
+    // before the next chunk is read
+    m_streamed = true;
+    m_keepAST  = m_options.emitAST;
+    m_parser.shareNodes(!m_keepAST);
+
+    LexerToken token = programToken();
+    while (auto chunk = stream.nextStatement())
     {
-        LexerToken token;
+        m_parser.reset(*chunk, stream.firstLine());
+        // The parser forgot the subtrees of the previous chunk, so their hashes may come back for others
+        m_semantic.forgetSharedTypes();
         m_parser.advanceToken(token);
+        const bool more = compileStatements(token);
+        flushChunk();
+        if (!more)
+            break;
+        // Every chunk after the first starts on a fresh line
+        token = {"\\n", noSourceOffset, LexerTokenType::Newline};
+    }
+    return finish();
+}
 
-        while (token.type != LexerTokenType::Eof)
+void Compiler::flushChunk()
+{
+    // Only the last chunk's Eof ends the program; the others are dropped when the next chunk comes
+    m_streamedEof = nlohmann::json::array();
+    if (m_options.emitLexer)
+        m_parser.addTokensToOutput(&m_streamedEof);
+
+    if (!m_keepAST)
+        return;
+    // A program with errors has no AST section
+    if (m_diagnostics.empty() && !m_statements.empty())
+    {
+        auto chunk = m_parser.astToJson(m_ast, m_ast.addBlock(programToken(), m_statements));
+        for (auto& statement : chunk["children"])
+            m_streamedAST.push_back(std::move(statement));
+    }
+    m_statements.clear();
+    m_ast.clear();
+}
+
+bool Compiler::compileStatements(LexerToken& token)
+{
+    while (token.type != LexerTokenType::Eof)
+    {
+        if (!advanceStatement(token, compileStatement(token)))
+            return false;
+    }
+    return true;
+}
+
+bool Compiler::advanceStatement(LexerToken& token, Expected<void> compiled)
+{
+    if (!compiled)
+    {
+        m_arena.reset();
+        // The token stream ends at a lexical error, so there is nothing to resume
+        if (!reportError(compiled.error()) || compiled.error().getType() == ErrorType::LEXICAL)
+            return false;
+        m_parser.synchronize(token);
+    }
+    m_parser.advancePastNewlines(token);
+    return true;
+}
+
+Expected<void> Compiler::compileStatement(LexerToken& token)
+{
+    const auto start      = m_parser.position();
+    const auto startToken = token;
+    auto       node       = m_parser.tryParseStatement(token);
+    if (!node)
+        return Unexpected(node.error());
+    // The statement ran into a lexical error, which comes before anything wrong with the statement
+    if (token.type == LexerTokenType::Unknown)
+        return Unexpected(*m_parser.tokens().error());
+
+    // The statement was parsed whole, so after a semantic error parsing goes on from where it is
+    if (auto processed = tryProcessNode(*node); !processed)
+    {
+        Error error = locateError(processed.error(), start, startToken);
+        if (!reportError(error))
+            return Unexpected(std::move(error));
+    }
+    // The statement is analyzed, generated and flattened; its nodes are no longer needed
+    m_arena.reset();
+    return expectStatementEnd(token);
+}
+
+Expected<void> Compiler::expectStatementEnd(const LexerToken& token)
+{
+    if (!m_parser.expectNewlineOrEOF(token))
+        return Unexpected(
+            Error("Expected new line before " + std::string(token.value), token.offset, ErrorType::SYNTAX));
+    return {};
+}
+
+#if defined(__EMSCRIPTEN__)
+bool Compiler::compilePipelined(LexerToken&)
+{
+    // No threads in the browser build
+    return true;
+}
+#else
+namespace
+{
+//! A top-level statement on its way from the parser to the code generator
+struct PipelinedStatement
+{
+    ASTNode*         node  = nullptr; // null marks the end of the input
+    Arena*           arena = nullptr; // holds the statement's nodes until it is generated
+    Parser::Position start{};         // where the parser stood right before the statement
+    LexerToken       first;           // the statement's first token
+    Parser::Position end{};           // where the parser stood right after the statement
+    LexerToken       next;            // the token following the statement
+    bool             generate = true; // false once the semantic stage has failed
+};
+
+//! First semantic error of a pipelined compilation, with the parser states around its statement
+struct PipelineFailure
+{
+    Error            error;
+    Parser::Position start;
+    LexerToken       first;
+    Parser::Position end;
+    LexerToken       next;
+};
+
+// Statements in flight at once. Each has an arena of its own, which bounds the pipeline's memory.
+constexpr size_t pipelineDepth = 32;
+} // namespace
+
+// The pipeline only handles statements without errors. A statement that fails in any stage stops it,
+// and compileStatements() continues from there, so errors come out exactly as on one thread.
+bool Compiler::compilePipelined(LexerToken& token)
+{
+    std::vector<Arena>             arenas(pipelineDepth);
+    SpscQueue<Arena*>              freeArenas(pipelineDepth); // code generator -> parser
+    SpscQueue<PipelinedStatement>  parsed(pipelineDepth);     // parser -> semantic
+    SpscQueue<PipelinedStatement>  analyzed(pipelineDepth);   // semantic -> code generator
+    std::optional<PipelineFailure> failure;
+    std::optional<Error>           generateFailure; // written by the code generator stage only
+    std::atomic<bool>              failed = false;
+    for (auto& arena : arenas)
+        freeArenas.push(&arena);
+
+    std::jthread semanticStage(
+        [&]
         {
-            if (auto node = m_parser.parseStatement(token))
+            for (auto statement = parsed.pop(); statement.node; statement = parsed.pop())
             {
-                processNode(node);
+                if (!failure)
+                {
+                    // The types the generator needs are annotated on the statement's nodes, so it
+                    // does not read the symbol table that later statements are changing
+                    auto result =
+                        m_options.fuseCodegen ? analyzeFused(*statement.node) : m_semantic.analyze(*statement.node);
+                    if (!result)
+                    {
+                        failure = PipelineFailure{
+                            result.error(), statement.start, statement.first, statement.end, statement.next};
+                        failed.store(true, std::memory_order_relaxed);
+                    }
+                }
+                // Statements after the failure still pass through, to hand their arenas back
+                statement.generate = !failure;
+                analyzed.push(std::move(statement));
             }
-            if (!m_parser.expectNewlineOrEOF(token))
+            analyzed.push({});
+        });
+
+    std::jthread codegenStage(
+        [&]
+        {
+            for (auto statement = analyzed.pop(); statement.node; statement = analyzed.pop())
             {
-                throw Error("Expected new line before " + std::string(token.value), token.location, ErrorType::SYNTAX);
+                if (statement.generate && !generateFailure)
+                {
+                    // Otherwise it was generated in the semantic stage
+                    auto generated = m_options.fuseCodegen ? Expected<void>{} : generate(*statement.node);
+                    if (!generated)
+                    {
+                        generateFailure = generated.error();
+                        failed.store(true, std::memory_order_relaxed);
+                    }
+                    else
+                    {
+                        ++m_statementCount;
+                        if (m_keepAST)
+                            m_statements.push_back(m_ast.append(*statement.node));
+                    }
+                }
+                statement.arena->reset();
+                freeArenas.push(statement.arena);
             }
+        });
 
-            m_parser.advancePastNewlines(token);
+    while (token.type != LexerTokenType::Eof && !failed.load(std::memory_order_relaxed))
+    {
+        const auto start      = m_parser.position();
+        const auto startToken = token;
+        Arena*     arena      = freeArenas.pop();
+        m_parser.useArena(*arena);
+
+        // The Diagnostics stay empty unless this statement recovered from an error inside a block
+        auto node = m_parser.tryParseStatement(token);
+        if (!node || !*node || token.type == LexerTokenType::Unknown || !m_diagnostics.empty() ||
+            !m_parser.expectNewlineOrEOF(token))
+        {
+            m_diagnostics.clear();
+            m_parser.rewind(start);
+            token = startToken;
+            break;
         }
-        collectOutputs();
-        return !m_root->children.empty();
+        parsed.push({*node, arena, start, startToken, m_parser.position(), token});
+        m_parser.advancePastNewlines(token);
     }
-    catch (const Error& e)
+    parsed.push({});
+    semanticStage.join();
+    codegenStage.join();
+    m_parser.useArena(m_arena);
+
+    // Later statements may have been analyzed already, so a statement the code generator rejects
+    // ends compilation
+    if (generateFailure)
     {
-        m_output.setError(e.what());
+        reportError(*generateFailure);
         return false;
     }
+    if (!failure)
+        return true;
+    // Carry on as compileStatement() does after a semantic error
+    m_parser.rewind(failure->end);
+    token                   = failure->next;
+    Error          error    = locateError(std::move(failure->error), failure->start, failure->first);
+    Expected<void> compiled = Unexpected(error);
+    if (reportError(error))
+        compiled = expectStatementEnd(token);
+    return advanceStatement(token, std::move(compiled));
+}
+#endif
+
+bool Compiler::reportError(Error& error)
+{
+    error.setLocation(m_parser.locate(error.getOffset()));
+    m_parser.markError();
+    return m_diagnostics.report(error) && !m_diagnostics.full();
+}
+
+bool Compiler::finish()
+{
+    if (m_diagnostics.empty())
+    {
+        collectOutputs();
+        return m_statementCount > 0;
+    }
+
+    if (m_options.emitLexer)
+        addTokensToOutput();
+    for (const auto& error : m_diagnostics.errors())
+        m_output.addError(error);
+    return false;
+}
+
+#if !defined(CURIOUSX_NO_EXCEPTIONS)
+void Compiler::processNode(ASTNode* node)
+{
+    if (auto processed = tryProcessNode(node); !processed)
+        throw processed.error();
+}
+#endif
+
+Expected<void> Compiler::tryProcessNode(ASTNode* node)
+{
+    // A program with errors produces no code, so generating any is wasted work
+    const bool generateCode = m_diagnostics.empty();
+    const bool fused        = generateCode && m_options.fuseCodegen;
+    if (auto analyzed = fused ? analyzeFused(*node) : m_semantic.analyze(*node); !analyzed)
+        return analyzed;
+    if (generateCode && !fused)
+    {
+        if (auto generated = generate(*node); !generated)
+            return generated;
+    }
+    ++m_statementCount;
+    if (m_keepAST)
+        m_statements.push_back(m_ast.append(*node));
+    return {};
+}
+
+Error Compiler::locateError(Error error, const Parser::Position& start, LexerToken token)
+{
+    if (!m_parser.sharesNodes())
+        return error;
+    // Errors are rare, so rather than track which occurrence of a shared node the analysis was in, the
+    // statement is parsed again with a node per occurrence and analyzed again up to the same error
+    const auto   end      = m_parser.position();
+    const size_t recorded = m_diagnostics.size();
+    m_parser.rewind(start);
+    m_parser.shareNodes(false);
+    if (auto node = m_parser.tryParseStatement(token); node && *node)
+    {
+        if (auto analyzed = m_semantic.analyze(**node); !analyzed)
+            error = analyzed.error();
+    }
+    m_parser.shareNodes(true);
+    m_parser.rewind(end);
+    // Errors the parser recovered from inside blocks were recorded the first time already
+    m_diagnostics.truncate(recorded);
+    return error;
+}
+
+Expected<void> Compiler::analyzeFused(const ASTNode& node)
+{
+    const bool fold       = m_options.foldConstants;
+    const auto checkpoint = m_codegen.checkpoint();
+    auto       analyzed   = fold ? m_semantic.analyze(node, m_folder) : m_semantic.analyze(node, m_codegen);
+    // As in two walks, where a statement with an error is never generated
+    if (!analyzed)
+    {
+        m_codegen.rollback(checkpoint);
+        if (fold)
+            m_folder.discardStatement();
+    }
+    else if (fold)
+        m_folder.endStatement();
+    return analyzed;
 }
 
-void Compiler::processNode(std::unique_ptr<ASTNode>& node)
+Expected<void> Compiler::generate(const ASTNode& node)
 {
-    m_semantic.analyzeTree(*node);
-    m_codegen.generate(*node);
-    m_root->children.emplace_back(std::move(node));
+    const bool fold       = m_options.foldConstants;
+    const auto checkpoint = m_codegen.checkpoint();
+    auto       generated  = fold ? m_codegen.generate(node, m_folder) : m_codegen.generate(node);
+    // As in analyzeFused(), a statement that fails part way leaves no code behind
+    if (!generated)
+    {
+        m_codegen.rollback(checkpoint);
+        if (fold)
+            m_folder.discardStatement();
+    }
+    else if (fold)
+        m_folder.endStatement();
+    return generated;
 }
+
 void Compiler::collectOutputs()
 {
-    m_parser.addASTToOutput(m_root);
+    if (m_options.emitLexer)
+        addTokensToOutput();
+    if (m_options.emitAST)
+        addASTToOutput();
     m_semantic.addSymbolTableToOutput();
     m_codegen.addGeneratedCodeToOutput();
 }
+
+void Compiler::addTokensToOutput()
+{
+    if (!m_streamed)
+        return m_parser.addTokensToOutput();
+    // The chunks wrote their tokens as they were compiled; only the end of the input is left
+    for (auto& token : m_streamedEof)
+        m_output.getJson()["Lexer"].push_back(std::move(token));
+}
+
+void Compiler::addASTToOutput()
+{
+    if (!m_streamed)
+        return m_parser.addASTToOutput(m_ast, programRoot());
+    auto program        = m_parser.astToJson(m_ast, m_ast.addBlock(programToken(), {}));
+    program["children"] = std::move(m_streamedAST);
+    m_output.getJson()["AST"] = std::move(program);
+}
+
+std::string Compiler::binaryAST()
+{
+    if (!m_keepAST || m_streamed || !m_diagnostics.empty())
+        return {};
+    return m_parser.binaryAST(m_ast, programRoot());
+}
+
+FlatAST::NodeId Compiler::programRoot()
+{
+    if (m_root == FlatAST::none)
+        m_root = m_ast.addBlock(programToken(), m_statements);
+    return m_root;
+}
@@ -1,23 +1,79 @@
 // Compiler.hpp
 #pragma once
+#include "CompilerOptions.hpp"
+#include "Diagnostics.hpp"
 #include "Generation/Codegen.hpp"
+#include "Optimizer/ConstantFolder.hpp"
 #include "Parser/Parser.hpp"
 #include "Semantic/Semantic.hpp"
+#include "SourceStream.hpp"
 #include <string_view>
+#include <vector>
 
 class Compiler
 {
   public:
-    Compiler(std::string_view source, CompilerOutput& output);
+    Compiler(std::string_view source, CompilerOutput& output, CompilerOptions options = {});
+    explicit Compiler(CompilerOutput& output, CompilerOptions options = {});
 
     bool compile();
+    //! Compiles the statements of `stream` as they are read. Only the statement being compiled is
+    //! kept in memory; the Lexer and AST sections are written as each statement is compiled, so the
+    //! output is the same as for the whole source, and memory stays bounded with both turned off.
+    bool compile(SourceStream& stream);
     void collectOutputs();
-    void processNode(std::unique_ptr<ASTNode>& node);
+    //! The program's AST in the binary format of BinaryAST.hpp, after compile() reported no errors; an
+    //! empty program gives an empty Program block. Empty when there were errors, and for streamed
+    //! input, whose AST is not kept past its statement
+    std::string    binaryAST();
+    //! Analyzes and generates one parsed statement, returning its first semantic error
+    Expected<void> tryProcessNode(ASTNode* node);
+#if !defined(CURIOUSX_NO_EXCEPTIONS)
+    //! Throwing form of tryProcessNode()
+    void           processNode(ASTNode* node);
+#endif
 
   private:
-    Parser                    m_parser;
-    Semantic                  m_semantic;
-    WasmGen                   m_codegen;
-    std::unique_ptr<TreeNode> m_root;
-    CompilerOutput            m_output;
+    //! Returns false once compilation has to stop: at a lexical error, or when no more errors fit
+    bool           compileStatements(LexerToken& token);
+    Expected<void> compileStatement(LexerToken& token);
+    //! Reports the outcome of the statement that ends at `token` and moves to the next one
+    bool           advanceStatement(LexerToken& token, Expected<void> compiled);
+    Expected<void> expectStatementEnd(const LexerToken& token);
+    //! Compiles on three threads up to the first statement with an error. Returns false once
+    //! compilation is over; otherwise compileStatements() resumes at `token`.
+    bool           compilePipelined(LexerToken& token);
+    //! Analyzes and generates `node` in one walk (CompilerOptions::fuseCodegen)
+    Expected<void> analyzeFused(const ASTNode& node);
+    //! Generates an analyzed statement, through the ConstantFolder with CompilerOptions::foldConstants
+    Expected<void> generate(const ASTNode& node);
+    //! `error` from analyzing the statement that starts at `start` with `token`. With shared nodes it
+    //! may point at the first occurrence of a subtree; it is moved to the occurrence it was found in.
+    Error          locateError(Error error, const Parser::Position& start, LexerToken token);
+    bool           reportError(Error& error);
+    bool           finish();
+    //! Writes the Lexer and AST sections of the streamed chunk just compiled, before its tokens go away
+    void           flushChunk();
+    void           addTokensToOutput();
+    void           addASTToOutput();
+    //! Block holding every statement compiled, added on first use
+    FlatAST::NodeId programRoot();
+
+    Diagnostics                  m_diagnostics;
+    Arena                        m_arena; // nodes of the statement being compiled
+    Parser                       m_parser;
+    ScopedSymbolTable            m_symbols; // variables of this compilation only
+    Semantic                     m_semantic;
+    WasmGen                      m_codegen;
+    ConstantFolder               m_folder; // passes code on to m_codegen
+    FlatAST                      m_ast; // every statement compiled so far, for the AST section
+    std::vector<FlatAST::NodeId> m_statements;
+    FlatAST::NodeId              m_root = FlatAST::none;
+    CompilerOutput&              m_output;
+    CompilerOptions              m_options;
+    bool                         m_keepAST;
+    bool                         m_streamed       = false;
+    nlohmann::json               m_streamedAST    = nlohmann::json::array(); // statements of earlier chunks
+    nlohmann::json               m_streamedEof    = nlohmann::json::array(); // final Eof of the last chunk
+    size_t                       m_statementCount = 0;
 };
@@ -1,45 +1,60 @@
 #include "Codegen.hpp"
 
-void WasmGen::generate(const ASTNode& node)
+Expected<void> WasmGen::generate(const ASTNode& node)
+{
+    return generate(node, *this);
+}
+
+Expected<void> WasmGen::generate(const ASTNode& node, CodeEmitter& emitter)
 {
     switch (node.getType())
     {
     case NodeType::BinaryOperation:
-        generateBinaryOp(static_cast<const BinaryNode&>(node));
-        break;
+        generateBinaryOp(static_cast<const BinaryNode&>(node), emitter);
+        return {};
     case NodeType::ConditionalOperation:
-        generateConditional(static_cast<const ConditionalNode&>(node));
-        break;
+        return generateConditional(static_cast<const ConditionalNode&>(node), emitter);
     case NodeType::BlockOperation:
-        generateBlock(static_cast<const TreeNode&>(node));
-        break;
+        return generateBlock(static_cast<const TreeNode&>(node), emitter);
     default:
-        throw Error("Unexpected type", node.token.location, ErrorType::SEMANTIC);
-        break;
+        return Unexpected(Error("Unexpected type", node.token.offset, ErrorType::SEMANTIC));
     }
 }
 
-void WasmGen::generateBinaryOp(const BinaryNode& node)
+void WasmGen::generateBinaryOp(const BinaryNode& node, CodeEmitter& emitter)
 {
     if (node.token.type == LexerTokenType::AssignToken)
     {
-        generateExpression(static_cast<const BinaryNode&>(*node.right));
-        int localIndex = getOrCreateLocalIndex(node.left->token.value);
-        addInstruction(WasmInstructionWithData(WasmInstruction::LocalSet, std::to_string(localIndex)));
+        generateExpression(static_cast<const BinaryNode&>(*node.right), emitter);
+        emitter.emitAssignment(node.left->token);
     }
     else
     {
-        generateExpression(node);
+        generateExpression(node, emitter);
     }
 }
 
-void WasmGen::generateExpression(const BinaryNode& node)
+void WasmGen::emitAssignment(const LexerToken& variable)
+{
+    int localIndex = getOrCreateLocalIndex(variable);
+    addInstruction(WasmInstructionWithData(WasmInstruction::LocalSet, std::to_string(localIndex)));
+}
+
+void WasmGen::emitConstant(InferredType type, std::string value)
+{
+    addInstruction(WasmInstructionWithData(type == InferredType::FLOAT ? WasmInstruction::F32Const
+                                                                       : WasmInstruction::I32Const,
+                                           std::move(value)));
+}
+
+void WasmGen::generateExpression(const BinaryNode& node, CodeEmitter& emitter)
 {
-    if (node.left)
-        generateExpression(static_cast<const BinaryNode&>(*node.left));
-    if (node.right)
-        generateExpression(static_cast<const BinaryNode&>(*node.right));
+    // Operands are pushed before their operator, which is exactly post-order
+    m_walker.postOrder(node, [&emitter](const ASTNode& n) { emitter.emit(static_cast<const BinaryNode&>(n)); });
+}
 
+void WasmGen::generateOperation(const BinaryNode& node)
+{
     bool isFloatOperation = isFloatType(static_cast<const BinaryNode&>(node));
 
     switch (node.token.type)
@@ -74,7 +89,7 @@ void WasmGen::generateExpression(const BinaryNode& node)
         break;
     case LexerTokenType::VarToken:
     {
-        int localIndex = getOrCreateLocalIndex(node.token.value);
+        int localIndex = getOrCreateLocalIndex(node.token);
         addInstruction(WasmInstructionWithData(WasmInstruction::LocalGet, std::to_string(localIndex)));
     }
     break;
@@ -102,15 +117,18 @@ void WasmGen::generateExpression(const BinaryNode& node)
     }
 }
 
-int WasmGen::getOrCreateLocalIndex(std::string_view varName)
+int WasmGen::getOrCreateLocalIndex(const LexerToken& variable)
 {
-    auto it = m_locals.find(std::string(varName));
-    if (it != m_locals.end())
+    const SymbolId id = m_symbols.idOf(variable);
+    if (id >= m_locals.size())
+        m_locals.resize(id + 1, -1);
+    if (m_locals[id] >= 0)
     {
-        return it->second;
+        return m_locals[id];
     }
-    int newIndex                   = m_nextLocalIndex++;
-    m_locals[std::string(varName)] = newIndex;
+    int newIndex  = m_nextLocalIndex++;
+    m_locals[id]  = newIndex;
+    m_localNames.push_back(id);
     return newIndex;
 }
 
@@ -122,7 +140,11 @@ void WasmGen::addInstruction(WasmInstructionWithData instruction)
 // Used lambda sike!!!! :)
 bool WasmGen::isFloatType(const BinaryNode& node)
 {
-    auto isFloatOperand = [](const std::unique_ptr<ASTNode>& operand) -> bool
+    if (node.type)
+        return *node.type == InferredType::FLOAT;
+
+    // Trees built without semantic analysis are typed by their direct operands
+    auto isFloatOperand = [this](const ASTNode* operand) -> bool
     {
         if (!operand)
             return false;
@@ -134,7 +156,7 @@ bool WasmGen::isFloatType(const BinaryNode& node)
 
         if (token.type == LexerTokenType::VarToken)
         {
-            if (auto type = ScopedSymbolTable::getInstance().lookup(std::string(token.value)))
+            if (auto type = m_symbols.lookup(m_symbols.idOf(token)))
             {
                 return *type == InferredType::FLOAT;
             }
@@ -146,35 +168,56 @@ bool WasmGen::isFloatType(const BinaryNode& node)
     return isFloatOperand(node.left) || isFloatOperand(node.right);
 }
 
-void WasmGen::generateConditional(const ConditionalNode& node)
+Expected<void> WasmGen::generateConditional(const ConditionalNode& node, CodeEmitter& emitter)
 {
     // Generate code for the condition
-    generateExpression(static_cast<const BinaryNode&>(*node.condition));
-    addInstruction(WasmInstructionWithData(WasmInstruction::If));
+    generateExpression(static_cast<const BinaryNode&>(*node.condition), emitter);
+    emitter.emitIf();
 
     // Generate code for the if block
-    generateBlock(*node.ifNode);
+    if (auto generated = generateBlock(*node.ifNode, emitter); !generated)
+        return generated;
 
     // Check if there's an else block
     if (node.elseNode)
     {
-        addInstruction(WasmInstructionWithData(WasmInstruction::Else));
-        generateBlock(*node.elseNode);
+        emitter.emitElse();
+        if (auto generated = generateBlock(*node.elseNode, emitter); !generated)
+            return generated;
     }
-    addInstruction(WasmInstructionWithData(WasmInstruction::End));
+    emitter.emitEnd();
+    return {};
 }
 
-void WasmGen::generateBlock(const TreeNode& node)
+Expected<void> WasmGen::generateBlock(const TreeNode& node, CodeEmitter& emitter)
 {
     auto operand = node.token;
     for (const auto& block : node.children)
     {
-        generate(*block);
+        if (auto generated = generate(*block, emitter); !generated)
+            return generated;
     }
     if (operand.type == LexerTokenType::PrintToken)
     {
-        addInstruction(WasmInstructionWithData(WasmInstruction::CallPrint));
+        emitter.emitPrint();
     }
+    return {};
+}
+
+WasmGen::Checkpoint WasmGen::checkpoint() const
+{
+    return {m_instructions.size(), m_localNames.size(), m_stringOffset};
+}
+
+void WasmGen::rollback(const Checkpoint& checkpoint)
+{
+    m_instructions.erase(m_instructions.begin() + static_cast<std::ptrdiff_t>(checkpoint.instructions),
+                         m_instructions.end());
+    for (size_t index = checkpoint.locals; index < m_localNames.size(); ++index)
+        m_locals[m_localNames[index]] = -1;
+    m_localNames.resize(checkpoint.locals);
+    m_nextLocalIndex = static_cast<int>(checkpoint.locals);
+    m_stringOffset   = checkpoint.stringOffset;
 }
 
 void WasmGen::addGeneratedCodeToOutput()
@@ -185,9 +228,10 @@ void WasmGen::addGeneratedCodeToOutput()
         instructionArray.push_back(instructionToString(instr));
     }
     m_output.getJson()["Gen"].push_back(instructionArray);
-    for (const auto& local : m_locals)
+    for (size_t index = 0; index < m_localNames.size(); ++index)
     {
-        m_output.getJson()["Local"].push_back({{"name", local.first}, {"index", local.second}});
+        m_output.getJson()["Local"].push_back(
+            {{"name", m_symbols.identifiers().name(m_localNames[index])}, {"index", index}});
     }
 }
 
@@ -1,39 +1,70 @@
 #pragma once
 
 #include <string_view>
-#include <unordered_map>
 #include <vector>
 
 #include "Semantic.hpp"
 #include "WasmInstructions.hpp"
 
-
-class WasmGen
+class WasmGen : public CodeEmitter
 {
   public:
-    explicit WasmGen(CompilerOutput& output): m_output(output){}
+    //! How much code had been generated at some point, to drop what came after it
+    struct Checkpoint
+    {
+        size_t instructions;
+        size_t locals;
+        int    stringOffset;
+    };
+
+    //! Local names are interned in `symbols`, which must outlive the generator
+    WasmGen(CompilerOutput& output, ScopedSymbolTable& symbols) : m_output(output), m_symbols(symbols) {}
+
+    //! Instructions are chosen by the types Semantic annotated `rootNode` with, so the symbol table
+    //! is not consulted and may already hold later statements. A node Semantic would have rejected is
+    //! returned as an error, with the code generated before it left in place.
+    Expected<void> generate(const ASTNode& rootNode);
+    //! Walks `rootNode` as generate() does but hands its code to `emitter`, a pass that forwards it to
+    //! this generator (ConstantFolder)
+    Expected<void> generate(const ASTNode& rootNode, CodeEmitter& emitter);
+    void           addGeneratedCodeToOutput();
+
+    // Code of a statement that Semantic checks and generates in one walk
+    void emit(const BinaryNode& node) override { generateOperation(node); }
+    void emitAssignment(const LexerToken& variable) override;
+    void emitIf() override { addInstruction(WasmInstructionWithData(WasmInstruction::If)); }
+    void emitElse() override { addInstruction(WasmInstructionWithData(WasmInstruction::Else)); }
+    void emitEnd() override { addInstruction(WasmInstructionWithData(WasmInstruction::End)); }
+    void emitPrint() override { addInstruction(WasmInstructionWithData(WasmInstruction::CallPrint)); }
+    //! Pushes a value computed at compile time, written as a literal of its type; BOOL is an i32
+    void emitConstant(InferredType type, std::string value);
 
-    void                                        generate(const ASTNode& rootNode);
-    void addGeneratedCodeToOutput();
+    Checkpoint checkpoint() const;
+    //! Forgets the instructions, locals and strings generated since `checkpoint`
+    void       rollback(const Checkpoint& checkpoint);
     const std::vector<WasmInstructionWithData> getInstructions() const;
 
   private:
     // Node traversal methods
-    void generateBinaryOp(const BinaryNode& node);
-    void generateConditional(const ConditionalNode& node);
-    void generateBlock(const TreeNode& node);
+    void           generateBinaryOp(const BinaryNode& node, CodeEmitter& emitter);
+    Expected<void> generateConditional(const ConditionalNode& node, CodeEmitter& emitter);
+    Expected<void> generateBlock(const TreeNode& node, CodeEmitter& emitter);
     // Expression generation methods
-    void generateExpression(const BinaryNode& node);
+    void generateExpression(const BinaryNode& node, CodeEmitter& emitter);
+    void generateOperation(const BinaryNode& node);
 
     // Helper methods
     bool isFloatType(const BinaryNode& node);
-    int  getOrCreateLocalIndex(std::string_view varName);
+    int  getOrCreateLocalIndex(const LexerToken& variable);
     void addInstruction(WasmInstructionWithData instruction);
 
     // Data members
-    std::unordered_map<std::string, int> m_locals;
+    std::vector<int>                     m_locals;     // local index by SymbolId; -1 when not assigned one yet
+    std::vector<SymbolId>                m_localNames; // SymbolId by local index
     std::vector<WasmInstructionWithData> m_instructions;
     int                                  m_nextLocalIndex = 0;
     int                                  m_stringOffset = 0;
-    CompilerOutput&        m_output;
+    CompilerOutput&          m_output;
+    ScopedSymbolTable&       m_symbols;
+    AstWalker                m_walker;
 };
\ No newline at end of file
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include "LexerToken.hpp"
+
+//! Dispatch class of a source byte, used by the lexer to pick a scanning routine
+enum class CharClass : std::uint8_t
+{
+    Unknown,
+    Eof,
+    Single, // complete single-character token, see CharInfo::token
+    Space,
+    Comment,
+    Bang,
+    Greater,
+    Less,
+    Equal,
+    Quote,
+    Alpha,
+    Digit
+};
+
+struct CharInfo
+{
+    CharClass      cls   = CharClass::Unknown;
+    LexerTokenType token = LexerTokenType::Unknown;
+    bool           ident = false; // may continue an identifier or number: [A-Za-z0-9.]
+};
+
+namespace detail
+{
+constexpr std::array<CharInfo, 256> buildCharTable()
+{
+    std::array<CharInfo, 256> table{};
+
+    auto single = [&table](unsigned char c, LexerTokenType type) { table[c] = {CharClass::Single, type, false}; };
+    single('\n', LexerTokenType::Newline);
+    single('\t', LexerTokenType::Tab);
+    single('(', LexerTokenType::ParenOpen);
+    single(')', LexerTokenType::ParenClose);
+    single('{', LexerTokenType::BracesOpen);
+    single('}', LexerTokenType::BracesClose);
+    single('+', LexerTokenType::PlusToken);
+    single('/', LexerTokenType::DivideToken);
+    single('*', LexerTokenType::MultiplyToken);
+    single('-', LexerTokenType::MinusToken);
+
+    table['\0'] = {CharClass::Eof, LexerTokenType::Eof, false};
+    table[' ']  = {CharClass::Space, LexerTokenType::Space, false};
+    table['#']  = {CharClass::Comment, LexerTokenType::CommentToken, false};
+    table['!']  = {CharClass::Bang, LexerTokenType::NotEqualToken, false};
+    table['>']  = {CharClass::Greater, LexerTokenType::GreaterToken, false};
+    table['<']  = {CharClass::Less, LexerTokenType::LessToken, false};
+    table['=']  = {CharClass::Equal, LexerTokenType::AssignToken, false};
+    table['"']  = {CharClass::Quote, LexerTokenType::StringToken, false};
+    table['.']  = {CharClass::Unknown, LexerTokenType::Unknown, true};
+
+    for (unsigned c = 'a'; c <= 'z'; ++c)
+    {
+        table[c]        = {CharClass::Alpha, LexerTokenType::VarToken, true};
+        table[c - 0x20] = {CharClass::Alpha, LexerTokenType::VarToken, true};
+    }
+    for (unsigned c = '0'; c <= '9'; ++c)
+    {
+        table[c] = {CharClass::Digit, LexerTokenType::IntToken, true};
+    }
+    return table;
+}
+} // namespace detail
+
+//! 256-entry classification table indexed by the raw (unsigned) source byte
+inline constexpr std::array<CharInfo, 256> charTable = detail::buildCharTable();
+
+constexpr const CharInfo& classify(char c)
+{
+    return charTable[static_cast<unsigned char>(c)];
+}
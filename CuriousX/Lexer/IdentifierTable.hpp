@@ -0,0 +1,48 @@
+#pragma once
+
+#include <deque>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "LexerToken.hpp"
+
+//! Interns variable names: each distinct name gets a dense SymbolId, in order of first appearance,
+//! so later passes can index plain vectors by it instead of hashing strings. The table owns copies of
+//! the names; IDs and names stay valid for its whole lifetime, across every source interned into it.
+class IdentifierTable
+{
+  public:
+    IdentifierTable() = default;
+    IdentifierTable(const IdentifierTable&)            = delete;
+    IdentifierTable& operator=(const IdentifierTable&) = delete;
+
+    //! ID of `name`, assigning the next one on its first appearance
+    SymbolId intern(std::string_view name)
+    {
+        auto it = m_ids.find(name);
+        if (it != m_ids.end())
+            return it->second;
+        const auto id = static_cast<SymbolId>(m_names.size());
+        m_ids.emplace(m_names.emplace_back(name), id);
+        return id;
+    }
+
+    //! ID of `name` if it was interned
+    std::optional<SymbolId> find(std::string_view name) const
+    {
+        auto it = m_ids.find(name);
+        return it == m_ids.end() ? std::nullopt : std::optional<SymbolId>(it->second);
+    }
+
+    //! ID of a variable token: the one it was lexed with, or its name's for tokens built by hand
+    SymbolId idOf(const LexerToken& token) { return token.symbol != noSymbol ? token.symbol : intern(token.value); }
+
+    std::string_view name(SymbolId id) const { return m_names[id]; }
+    size_t           size() const { return m_names.size(); }
+
+  private:
+    std::deque<std::string>                        m_names; // a deque never moves them, so views stay valid
+    std::unordered_map<std::string_view, SymbolId> m_ids;
+};
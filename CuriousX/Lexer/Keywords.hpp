@@ -0,0 +1,116 @@
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////
+/// Keyword recognition through a perfect hash generated at compile time.
+/// The hash only looks at an identifier's length and its first and last
+/// characters; a single comparison against the slot's spelling confirms the
+/// match. To add a keyword, append it to `keywordList` below.
+///////////////////////////////////////////////////////////////////////////
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+#include "LexerToken.hpp"
+
+struct Keyword
+{
+    std::string_view spelling;
+    LexerTokenType   type = LexerTokenType::VarToken;
+};
+
+inline constexpr Keyword keywordList[] = {
+    {"print", LexerTokenType::PrintToken},
+    {"Print", LexerTokenType::PrintToken},
+    {"if", LexerTokenType::IfToken},
+    {"else", LexerTokenType::ElseToken},
+    {"true", LexerTokenType::BoolToken},
+    {"false", LexerTokenType::BoolToken},
+};
+
+namespace keyword_detail
+{
+constexpr unsigned tableBits = 4;
+constexpr size_t   tableSize = size_t{1} << tableBits;
+static_assert(std::size(keywordList) <= tableSize, "grow tableBits to fit the keyword list");
+
+constexpr size_t shortestKeyword()
+{
+    size_t result = keywordList[0].spelling.size();
+    for (const auto& k : keywordList)
+        result = k.spelling.size() < result ? k.spelling.size() : result;
+    return result;
+}
+
+constexpr size_t longestKeyword()
+{
+    size_t result = 0;
+    for (const auto& k : keywordList)
+        result = k.spelling.size() > result ? k.spelling.size() : result;
+    return result;
+}
+
+// Computed once, so classifyKeyword() compares against constants even in unoptimized builds
+inline constexpr size_t minLength = shortestKeyword();
+inline constexpr size_t maxLength = longestKeyword();
+
+// Multiplicative hash of (length, first, last); the top bits select the slot
+constexpr size_t slotOf(std::string_view word, std::uint32_t seed)
+{
+    const std::uint32_t key = static_cast<unsigned char>(word.front()) |
+                              static_cast<std::uint32_t>(static_cast<unsigned char>(word.back())) << 8 |
+                              static_cast<std::uint32_t>(word.size()) << 16;
+    return static_cast<std::uint32_t>(key * seed) >> (32 - tableBits);
+}
+
+constexpr bool isCollisionFree(std::uint32_t seed)
+{
+    std::array<bool, tableSize> used{};
+    for (const auto& k : keywordList)
+    {
+        auto slot = slotOf(k.spelling, seed);
+        if (used[slot])
+            return false;
+        used[slot] = true;
+    }
+    return true;
+}
+
+constexpr std::uint32_t findSeed()
+{
+    for (std::uint32_t seed = 2654435769u; seed != 2654435769u + 2 * 100000; seed += 2)
+    {
+        if (isCollisionFree(seed))
+            return seed;
+    }
+    return 0;
+}
+
+constexpr std::uint32_t seed = findSeed();
+static_assert(seed != 0, "no perfect hash seed found for the keyword list");
+
+constexpr std::array<Keyword, tableSize> buildTable()
+{
+    std::array<Keyword, tableSize> table{};
+    for (const auto& k : keywordList)
+        table[slotOf(k.spelling, seed)] = k;
+    return table;
+}
+
+constexpr std::array<Keyword, tableSize> table = buildTable();
+} // namespace keyword_detail
+
+//! Returns the keyword token type for `word`, or VarToken if it is not a keyword
+constexpr LexerTokenType classifyKeyword(std::string_view word)
+{
+    if (word.size() < keyword_detail::minLength || word.size() > keyword_detail::maxLength)
+        return LexerTokenType::VarToken;
+
+    const Keyword& candidate = keyword_detail::table[keyword_detail::slotOf(word, keyword_detail::seed)];
+    return candidate.spelling == word ? candidate.type : LexerTokenType::VarToken;
+}
+
+static_assert(classifyKeyword("print") == LexerTokenType::PrintToken);
+static_assert(classifyKeyword("else") == LexerTokenType::ElseToken);
+static_assert(classifyKeyword("elsewhere") == LexerTokenType::VarToken);
+static_assert(classifyKeyword("tru") == LexerTokenType::VarToken);
@@ -1,220 +1,385 @@
 #pragma once
 
 #include <algorithm>
-#include <optional>
+#include <future>
 #include <string_view>
-#include <unordered_map>
+#include <vector>
 
-#include "LexerToken.hpp"
+#include "CharTable.hpp"
 #include "Error.hpp"
+#include "Expected.hpp"
+#include "Keywords.hpp"
+#include "LexerToken.hpp"
+#include "ScanKernels.hpp"
+#include "ThreadPool.hpp"
+#include "TokenBuffer.hpp"
+
+//! A change to the source: `removed` bytes at `offset` were replaced by `inserted`
+struct TextEdit
+{
+    std::uint32_t    offset  = 0;
+    std::uint32_t    removed = 0;
+    std::string_view inserted;
+};
 
 class Lexer
 {
   public:
-    explicit Lexer(std::string_view data) : data(data) {}
+    explicit Lexer(std::string_view data, size_t start = 0) : data(data), pos(start) {}
 
-    LexerToken nextNWToken()
+    //! The next token that is not whitespace, or the lexical error in the way
+    Expected<LexerToken> tryNextNWToken()
     {
-        LexerToken t;
-        do
+        while (true)
         {
-            t = nextToken();
-        } while (t.type == LexerTokenType::Space || t.type == LexerTokenType::Tab);
-        return t;
+            auto t = doGetNextToken();
+            if (!t || (t->type != LexerTokenType::Space && t->type != LexerTokenType::Tab))
+                return t;
+        }
     }
 
-    LexerToken nextToken() { return doGetNextToken(); }
-
-  private:
-    std::string_view data;
-    size_t           pos   = 0;
-    unsigned short   x_pos = 1;
-    unsigned short   y_pos = 1;
+    Expected<LexerToken> tryNextToken() { return doGetNextToken(); }
 
-    struct Checkpoint
+#if !defined(CURIOUSX_NO_EXCEPTIONS)
+    //! Throwing forms of tryNextNWToken() and tryNextToken()
+    LexerToken nextNWToken()
     {
-        size_t         pos;
-        unsigned short x_pos;
-        unsigned short y_pos;
-    };
-
-    std::optional<Checkpoint> checkpoint;
-
-    void saveCheckpoint() { checkpoint = Checkpoint{pos, x_pos, y_pos}; }
+        auto t = tryNextNWToken();
+        if (!t)
+            throw t.error();
+        return *t;
+    }
 
-    void restoreCheckpoint()
+    LexerToken nextToken()
     {
-        if (checkpoint)
-        {
-            pos   = checkpoint->pos;
-            x_pos = checkpoint->x_pos;
-            y_pos = checkpoint->y_pos;
-            checkpoint.reset();
-        }
+        auto t = tryNextToken();
+        if (!t)
+            throw t.error();
+        return *t;
     }
+#endif
 
-    char next_char()
+    //! Lexes the remaining source in one pass, dropping whitespace. A lexical error
+    //! terminates the buffer instead of propagating, so it surfaces when consumed.
+    TokenBuffer tokenizeAll()
     {
-        if (pos >= data.size())
-            return '\0';
-        char c = data[pos++];
-        if (c == '\n')
-        {
-            y_pos++;
-            x_pos = 1;
-        }
-        else
+        TokenBuffer buffer(data);
+        // Typical sources average well over four bytes per non-whitespace token
+        buffer.reserve(data.size() / 4 + 1);
+
+        while (true)
         {
-            x_pos++;
+            const size_t startPos = pos;
+            const auto   token    = doGetNextToken();
+            if (!token)
+            {
+                buffer.fail(token.error(), static_cast<std::uint32_t>(startPos));
+                break;
+            }
+            if (token->type == LexerTokenType::Space || token->type == LexerTokenType::Tab)
+                continue;
+
+            buffer.push(token->type, token->offset, static_cast<std::uint32_t>(pos - startPos));
+            if (token->type == LexerTokenType::Eof)
+                break;
         }
-        return c;
+        return buffer;
     }
 
-    char peek_next_char() const { return pos < data.size() ? data[pos] : '\0'; }
-
-    SourceLocation currentLocation() const { return SourceLocation(y_pos, x_pos); }
+    //! Sources at least this large are lexed in parallel by tokenize() when it is given a pool
+    static constexpr size_t parallelThreshold = size_t{1} << 20;
 
-    static bool isInt(std::string_view data)
+    //! Lexes `source` on the calling thread, or across `pool` when there is one and the source is
+    //! large enough
+    static TokenBuffer tokenize(std::string_view source, ThreadPool* pool = nullptr)
     {
-        return std::all_of(
-            data.begin(), data.end(), [](char c) { return std::isdigit(static_cast<unsigned char>(c)); });
+#if !defined(__EMSCRIPTEN__)
+        if (pool && source.size() >= parallelThreshold)
+            return Lexer(source).tokenizeAll(*pool);
+#endif
+        return Lexer(source).tokenizeAll();
     }
 
-    LexerToken handleComment(size_t startPos, const SourceLocation& location)
+    //! Same result as tokenizeAll(), but lexes the source as newline-aligned chunks on `pool`.
+    //! No token spans a newline, so every chunk starts in the lexer's initial state; the chunk
+    //! buffers are then stitched together with their offsets rebased onto the whole source.
+    //! Called from one of the pool's own workers, it lexes on that thread, since waiting there for
+    //! the chunks could leave no worker free to lex them.
+    TokenBuffer tokenizeAll(ThreadPool& pool, size_t minChunkSize = parallelThreshold / 8)
     {
-        while (true)
+        const size_t chunkCount = std::min(pool.size() * 4, (data.size() - pos) / std::max<size_t>(minChunkSize, 1));
+        if (chunkCount < 2 || pool.onWorkerThread())
+            return tokenizeAll();
+
+        // Chunk k covers [bounds[k], bounds[k + 1]); every inner bound follows a '\n'
+        std::vector<size_t> bounds{pos};
+        for (size_t k = 1; k < chunkCount; ++k)
         {
-            char c = peek_next_char();
-            if (c == '\n' || c == '\0')
+            const size_t target = std::max(pos + (data.size() - pos) * k / chunkCount, bounds.back());
+            const size_t nl     = data.find('\n', target);
+            if (nl == std::string_view::npos)
                 break;
-            next_char();
+            if (nl + 1 > bounds.back())
+                bounds.push_back(nl + 1);
         }
-        return {data.substr(startPos, pos - startPos), location, LexerTokenType::CommentToken};
-    }
+        if (bounds.back() != data.size())
+            bounds.push_back(data.size());
 
-    LexerToken doGetNextToken()
-    {
-        const SourceLocation location = currentLocation();
-        const auto           startPos = pos;
-        const char           nchar    = next_char();
-
-        // Map of single-character tokens
-        static const std::unordered_map<char, std::pair<std::string_view, LexerTokenType>> singleCharTokens = {
-            {'\0', {"\0", LexerTokenType::Eof}},
-            {'\n', {"\\n", LexerTokenType::Newline}},
-            {'\t', {"\t", LexerTokenType::Tab}},
-            {'(', {"(", LexerTokenType::ParenOpen}},
-            {')', {")", LexerTokenType::ParenClose}},
-            {'{', {"{", LexerTokenType::BracesOpen}},
-            {'}', {"}", LexerTokenType::BracesClose}},
-            {'+', {"+", LexerTokenType::PlusToken}},
-            {'/', {"/", LexerTokenType::DivideToken}},
-            {'*', {"*", LexerTokenType::MultiplyToken}},
-            {'-', {"-", LexerTokenType::MinusToken}}};
-
-        // Check for single-character tokens
-        if (auto it = singleCharTokens.find(nchar); it != singleCharTokens.end())
+        std::vector<std::future<TokenBuffer>> lexed;
+        for (size_t k = 0; k + 1 < bounds.size(); ++k)
         {
-            return {it->second.first, location, it->second.second};
+            const auto chunk = data.substr(bounds[k], bounds[k + 1] - bounds[k]);
+            lexed.push_back(pool.submit([chunk] { return Lexer(chunk).tokenizeAll(); }));
         }
 
-        if (nchar == ' ')
-            return {fetch_consecutive(startPos, ' '), location, LexerTokenType::Space};
-        if (nchar == '#')
-            return handleComment(startPos, location);
-
-        if (nchar == '!')
+        // Every chunk but the one that ends the stream drops its Eof. An error, or an Eof before the end
+        // of its chunk (an embedded NUL), ends the stream early just as it does for a sequential lex.
+        std::vector<TokenBuffer> chunks;
+        std::vector<size_t>      starts{0};
+        std::optional<Error>     error;
+        for (size_t k = 0; k < lexed.size(); ++k)
         {
-            if (next_char() == '=')
-                return {data.substr(startPos, 2), location, LexerTokenType::NotEqualToken};
-            throw Error("Lexical Error- Unexpected character after '!' ", location, ErrorType::LEXICAL);
+            chunks.push_back(lexed[k].get());
+            const auto&  chunk = chunks.back();
+            const size_t last  = chunk.size() - 1;
+            const auto   base  = static_cast<std::uint32_t>(bounds[k]);
+
+            bool ends = k + 1 == lexed.size();
+            if (chunk.type(last) == LexerTokenType::Unknown)
+            {
+                const Error& e = *chunk.error();
+                error.emplace(e.getMessage(), e.getOffset() + base, e.getType());
+                ends = true;
+            }
+            else if (chunk.offset(last) < bounds[k + 1] - bounds[k])
+            {
+                ends = true;
+            }
+
+            starts.push_back(starts.back() + (ends ? chunk.size() : last));
+            if (ends)
+                break;
         }
+        // Chunks past the end of the stream are unused, but still read the source until they finish
+        for (size_t k = chunks.size(); k < lexed.size(); ++k)
+            lexed[k].wait();
 
-        if (nchar == '>')
+        TokenBuffer buffer(data);
+        buffer.resize(starts.back());
+        std::vector<std::future<void>> placed;
+        for (size_t k = 0; k < chunks.size(); ++k)
         {
-            saveCheckpoint();
-            if (next_char() == '=')
-                return {data.substr(startPos, 2), location, LexerTokenType::GreaterEqualToken};
-            restoreCheckpoint();
-            return {">", location, LexerTokenType::GreaterToken};
+            placed.push_back(pool.submit(
+                [&, k] { buffer.place(starts[k], chunks[k], starts[k + 1] - starts[k], static_cast<std::uint32_t>(bounds[k])); }));
         }
+        for (auto& task : placed)
+            task.get();
+
+        if (error)
+            buffer.setError(*error);
+        return buffer;
+    }
+
+    //! Updates `tokens`, lexed from the source before `edit`, to match the edited `source`.
+    //! Lexing restarts at the beginning of the first edited line and stops as soon as a token
+    //! past the edit starts where an old token started (shifted by the edit); from there on the
+    //! old tokens are kept and only their offsets move.
+    static void relex(TokenBuffer& tokens, std::string_view source, const TextEdit& edit)
+    {
+        const std::int64_t delta     = static_cast<std::int64_t>(edit.inserted.size()) - edit.removed;
+        const size_t       editEnd   = edit.offset + edit.inserted.size();
+        const size_t       lineBreak = source.substr(0, edit.offset).rfind('\n');
+        const size_t       lineStart = lineBreak == std::string_view::npos ? 0 : lineBreak + 1;
+
+        tokens.setSource(source);
+        const size_t first = tokens.lowerBound(static_cast<std::uint32_t>(lineStart));
+        if (first == tokens.size())
+            return; // the old stream already ended before the edited line
 
-        if (nchar == '<')
+        TokenBuffer fresh(source);
+        Lexer       lexer(source, lineStart);
+        size_t      resync   = tokens.size(); // first old entry kept after the relexed range
+        size_t      old      = first;
+        while (true)
         {
-            saveCheckpoint();
-            if (next_char() == '=')
-                return {data.substr(startPos, 2), location, LexerTokenType::LessEqualToken};
-            restoreCheckpoint();
-            return {"<", location, LexerTokenType::LessToken};
+            const size_t startPos = lexer.pos;
+            const auto   token    = lexer.doGetNextToken();
+            if (!token)
+            {
+                fresh.fail(token.error(), static_cast<std::uint32_t>(startPos));
+                break;
+            }
+            if (token->type == LexerTokenType::Space || token->type == LexerTokenType::Tab)
+                continue;
+
+            if (token->offset >= editEnd)
+            {
+                const auto oldOffset = static_cast<std::int64_t>(token->offset) - delta;
+                while (old < tokens.size() && tokens.offset(old) < oldOffset)
+                    ++old;
+                if (old < tokens.size() && tokens.offset(old) == oldOffset)
+                {
+                    resync = old;
+                    break;
+                }
+            }
+
+            fresh.push(token->type, token->offset, static_cast<std::uint32_t>(lexer.pos - startPos));
+            if (token->type == LexerTokenType::Eof)
+                break;
         }
 
-        if (nchar == '=')
+        if (resync == tokens.size())
         {
-            saveCheckpoint();
-            if (next_char() == '=')
-                return {data.substr(startPos, 2), location, LexerTokenType::EqualToken};
-            restoreCheckpoint();
-            return {"=", location, LexerTokenType::AssignToken};
+            // The new stream ended on its own; nothing of the old tail survives
+            tokens.splice(first, tokens.size(), fresh);
+            if (fresh.error())
+                tokens.setError(*fresh.error());
+            else
+                tokens.clearError();
+            return;
         }
 
-        if (nchar == '"')
+        tokens.splice(first, resync, fresh);
+        tokens.shift(first + fresh.size(), delta);
+        if (const auto& error = tokens.error())
+            tokens.setError(Error(error->getMessage(), static_cast<std::uint32_t>(error->getOffset() + delta),
+                                  error->getType()));
+    }
+
+  private:
+    std::string_view data;
+    size_t           pos = 0;
+
+    char next_char() { return pos < data.size() ? data[pos++] : '\0'; }
+
+    char peek_next_char() const { return pos < data.size() ? data[pos] : '\0'; }
+
+    void advance_to(const char* to) { pos = static_cast<size_t>(to - data.data()); }
+
+    const char* cursor() const { return data.data() + pos; }
+    const char* end() const { return data.data() + data.size(); }
+
+    LexerToken handleComment(size_t startPos, std::uint32_t offset)
+    {
+        advance_to(scan::skipLineBody(cursor(), end()));
+        return {data.substr(startPos, pos - startPos), offset, LexerTokenType::CommentToken};
+    }
+
+    // Two-character operators ending in '=' (>=, <=, ==); falls back to the single-character form
+    LexerToken handleOperator(size_t           startPos,
+                              std::uint32_t    offset,
+                              std::string_view single,
+                              LexerTokenType   singleType,
+                              LexerTokenType   doubleType)
+    {
+        if (peek_next_char() == '=')
         {
-            size_t count = 1;
-            auto   t     = next_char();
-            while (t != '"')
-            {
-                if (t == '\0' || t == '\n')
-                    throw Error("Unclosed string literal", location, ErrorType::LEXICAL);
-                count++;
-                t = next_char();
-            }
-            return {data.substr(startPos, count + 1), location, LexerTokenType::StringToken};
+            next_char();
+            return {data.substr(startPos, 2), offset, doubleType};
         }
+        return {single, offset, singleType};
+    }
 
-        if (!(std::isalpha(nchar) || std::isdigit(nchar)))
+    // Errors are returned rather than thrown: invalid input is common, and unwinding is costly
+    Expected<LexerToken> doGetNextToken()
+    {
+        const auto      startPos = pos;
+        const auto      offset   = static_cast<std::uint32_t>(startPos);
+        const char      nchar    = next_char();
+        const CharInfo& info     = classify(nchar);
+
+        switch (info.cls)
         {
-            throw Error(" Lexical Error- Unknown character", location, ErrorType::LEXICAL);
+        case CharClass::Eof:
+            return LexerToken{"\0", offset, LexerTokenType::Eof};
+        case CharClass::Single:
+            return LexerToken{singleCharValue(nchar), offset, info.token};
+        case CharClass::Space:
+            advance_to(scan::skipSpaces(cursor(), end()));
+            return LexerToken{data.substr(startPos, pos - startPos), offset, LexerTokenType::Space};
+        case CharClass::Comment:
+            return handleComment(startPos, offset);
+        case CharClass::Bang:
+            if (next_char() == '=')
+                return LexerToken{data.substr(startPos, 2), offset, LexerTokenType::NotEqualToken};
+            return Unexpected(Error("Lexical Error- Unexpected character after '!' ", offset, ErrorType::LEXICAL));
+        case CharClass::Greater:
+            return handleOperator(
+                startPos, offset, ">", LexerTokenType::GreaterToken, LexerTokenType::GreaterEqualToken);
+        case CharClass::Less:
+            return handleOperator(startPos, offset, "<", LexerTokenType::LessToken, LexerTokenType::LessEqualToken);
+        case CharClass::Equal:
+            return handleOperator(startPos, offset, "=", LexerTokenType::AssignToken, LexerTokenType::EqualToken);
+        case CharClass::Quote:
+            return handleString(startPos, offset);
+        case CharClass::Alpha:
+        case CharClass::Digit:
+            break;
+        default:
+            return Unexpected(Error(" Lexical Error- Unknown character", offset, ErrorType::LEXICAL));
         }
 
         // Handle numeric and keyword tokens
-        auto substr = next_valid_sequences(startPos);
-        if (std::all_of(substr.begin(), substr.end(), [](char c) { return std::isdigit(c) || c == '.'; }))
+        advance_to(scan::skipIdentifier(cursor(), end()));
+        auto substr = data.substr(startPos, pos - startPos);
+
+        bool numeric = true;
+        bool hasDot  = false;
+        for (char c : substr)
         {
-            return {substr,
-                    location,
-                    substr.find('.') == std::string::npos ? LexerTokenType::IntToken : LexerTokenType::FloatToken};
+            hasDot |= c == '.';
+            numeric &= c == '.' || classify(c).cls == CharClass::Digit;
         }
-
-        // Map of keyword tokens
-        static const std::unordered_map<std::string_view, LexerTokenType> keywords = {
-            {"print", LexerTokenType::PrintToken},
-            {"Print", LexerTokenType::PrintToken},
-            {"if", LexerTokenType::IfToken},
-            {"else", LexerTokenType::ElseToken},
-            {"true", LexerTokenType::BoolToken},
-            {"false", LexerTokenType::BoolToken}};
-
-        if (auto it = keywords.find(substr); it != keywords.end())
+        if (numeric)
         {
-            return {substr, location, it->second};
+            return LexerToken{substr, offset, hasDot ? LexerTokenType::FloatToken : LexerTokenType::IntToken};
         }
 
-        return {substr, location, LexerTokenType::VarToken};
+        return LexerToken{substr, offset, classifyKeyword(substr)};
     }
 
-    // Fetch consecutive occurrences of a character
-    std::string_view fetch_consecutive(size_t startPos, char ch)
+    Expected<LexerToken> handleString(size_t startPos, std::uint32_t offset)
     {
-        while (peek_next_char() == ch)
-            next_char();
-        return data.substr(startPos, pos - startPos);
+        // Strings cannot span lines, so the closing quote must precede the next '\n' or '\0'
+        const char* p = cursor();
+        while (true)
+        {
+            if (p == end() || *p == '\n' || *p == '\0')
+                return Unexpected(Error("Unclosed string literal", offset, ErrorType::LEXICAL));
+            if (*p == '"')
+                break;
+            ++p;
+        }
+        advance_to(p + 1);
+        return LexerToken{data.substr(startPos, pos - startPos), offset, LexerTokenType::StringToken};
     }
 
-    // Fetch next valid sequence of characters (for identifiers and numbers)
-    std::string_view next_valid_sequences(size_t from)
+    // Token text for single-character tokens; whitespace tokens keep their escaped spelling
+    static std::string_view singleCharValue(char c)
     {
-        while (std::isalnum(peek_next_char()) || peek_next_char() == '.')
-            next_char();
-        return data.substr(from, pos - from);
+        switch (c)
+        {
+        case '\n':
+            return "\\n";
+        case '\t':
+            return "\t";
+        case '(':
+            return "(";
+        case ')':
+            return ")";
+        case '{':
+            return "{";
+        case '}':
+            return "}";
+        case '+':
+            return "+";
+        case '/':
+            return "/";
+        case '*':
+            return "*";
+        default:
+            return "-";
+        }
     }
 };
\ No newline at end of file
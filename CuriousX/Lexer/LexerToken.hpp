@@ -1,9 +1,11 @@
 #pragma once
 
 #include "SourceLocation.hpp"
+#include <cstdint>
+#include <limits>
 #include <string_view>
 
-enum class LexerTokenType
+enum class LexerTokenType : std::uint8_t
 {
     ParenOpen,
     ParenClose,
@@ -43,12 +45,21 @@ enum class LexerTokenType
     Unknown
 };
 
+//! Dense ID of an interned variable name (see IdentifierTable)
+using SymbolId = std::uint32_t;
+//! SymbolId of tokens that are not interned variables
+inline constexpr SymbolId noSymbol = std::numeric_limits<SymbolId>::max();
+//! Index of tokens that did not come from a TokenBuffer
+inline constexpr std::uint32_t noTokenIndex = std::numeric_limits<std::uint32_t>::max();
+
 //! Represents a single token in the expression stream
 struct LexerToken
 {
     std::string_view value;
-    SourceLocation location;
-    LexerTokenType type;
+    std::uint32_t    offset = noSourceOffset; // byte offset in the source
+    LexerTokenType   type   = LexerTokenType::Unknown;
+    SymbolId         symbol = noSymbol; // interned name of a VarToken, once its TokenBuffer was interned
+    std::uint32_t    index  = noTokenIndex; // position in the TokenBuffer the token was read from
 };
 
 //! Converts LexerToken to String
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "ScanKernels.hpp"
+#include "SourceLocation.hpp"
+
+//! Maps byte offsets to line/column positions. The table of line starts is built
+//! with one vectorized newline scan the first time a location is requested, so
+//! sources that compile without errors or JSON output never pay for it.
+class LineIndex
+{
+  public:
+    LineIndex() = default;
+    //! `firstLine` is the line number of the first byte, for sources that are a slice of a larger input
+    explicit LineIndex(std::string_view source, std::uint32_t firstLine = 1) : m_source(source), m_firstLine(firstLine)
+    {
+    }
+
+    //! 1-based line and column of `offset`; noSourceOffset maps to <line:0, col:0>
+    SourceLocation locate(std::uint32_t offset) const
+    {
+        if (offset == noSourceOffset)
+            return SourceLocation();
+        if (!m_built)
+            build();
+
+        auto it   = std::upper_bound(m_lineStarts.begin(), m_lineStarts.end(), offset);
+        auto line = static_cast<std::uint32_t>(it - m_lineStarts.begin()) + m_firstLine - 1;
+        return SourceLocation(line, offset - *(it - 1) + 1);
+    }
+
+    size_t lineCount() const
+    {
+        if (!m_built)
+            build();
+        return m_lineStarts.size();
+    }
+
+  private:
+    void build() const
+    {
+        m_lineStarts.assign(1, 0);
+        scan::collectLineStarts(m_source.data(), m_source.data() + m_source.size(), m_lineStarts);
+        m_built = true;
+    }
+
+    std::string_view                   m_source;
+    std::uint32_t                      m_firstLine = 1;
+    mutable std::vector<std::uint32_t> m_lineStarts;
+    mutable bool                       m_built = false;
+};
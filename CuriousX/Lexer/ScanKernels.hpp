@@ -0,0 +1,208 @@
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////
+/// Run-skipping kernels used by the lexer's hot loop. Each kernel returns a
+/// pointer to the first byte in [p, end) that terminates the run; the vector
+/// paths inspect 32 (AVX2) or 16 (SSE2) bytes per step and the scalar loop
+/// handles the tail and targets without SIMD support.
+///////////////////////////////////////////////////////////////////////////
+
+#include <bit>
+#include <cstdint>
+#include <vector>
+
+#include "CharTable.hpp"
+
+#if defined(__AVX2__)
+#define CURIOUSX_AVX2 1
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CURIOUSX_SSE2 1
+#endif
+
+#if defined(CURIOUSX_AVX2)
+#include <immintrin.h>
+#elif defined(CURIOUSX_SSE2)
+#include <emmintrin.h>
+#endif
+
+namespace scan
+{
+namespace detail
+{
+//! Run of ' ' characters
+struct SpaceRun
+{
+    static bool stops(char c) { return c != ' '; }
+#if defined(CURIOUSX_SSE2)
+    static unsigned stopMask(__m128i v)
+    {
+        return ~static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')))) & 0xFFFFu;
+    }
+#endif
+#if defined(CURIOUSX_AVX2)
+    static unsigned stopMask(__m256i v)
+    {
+        return ~static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' '))));
+    }
+#endif
+};
+
+//! Run of identifier/number characters: [A-Za-z0-9.]
+struct IdentRun
+{
+    static bool stops(char c) { return !classify(c).ident; }
+#if defined(CURIOUSX_SSE2)
+    static unsigned stopMask(__m128i v)
+    {
+        // Bytes >= 0x80 compare as negative and fall outside every range below
+        const __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+        const __m128i alpha =
+            _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)), _mm_cmpgt_epi8(_mm_set1_epi8('z' + 1), lower));
+        const __m128i digit =
+            _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('0' - 1)), _mm_cmpgt_epi8(_mm_set1_epi8('9' + 1), v));
+        const __m128i dot = _mm_cmpeq_epi8(v, _mm_set1_epi8('.'));
+        const __m128i ok  = _mm_or_si128(_mm_or_si128(alpha, digit), dot);
+        return ~static_cast<unsigned>(_mm_movemask_epi8(ok)) & 0xFFFFu;
+    }
+#endif
+#if defined(CURIOUSX_AVX2)
+    static unsigned stopMask(__m256i v)
+    {
+        const __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+        const __m256i alpha = _mm256_and_si256(_mm256_cmpgt_epi8(lower, _mm256_set1_epi8('a' - 1)),
+                                               _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), lower));
+        const __m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('0' - 1)),
+                                               _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), v));
+        const __m256i dot   = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('.'));
+        const __m256i ok    = _mm256_or_si256(_mm256_or_si256(alpha, digit), dot);
+        return ~static_cast<unsigned>(_mm256_movemask_epi8(ok));
+    }
+#endif
+};
+
+//! Body of a line comment: everything up to '\n' or '\0'
+struct LineBody
+{
+    static bool stops(char c) { return c == '\n' || c == '\0'; }
+#if defined(CURIOUSX_SSE2)
+    static unsigned stopMask(__m128i v)
+    {
+        const __m128i hit = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(v, _mm_setzero_si128()));
+        return static_cast<unsigned>(_mm_movemask_epi8(hit));
+    }
+#endif
+#if defined(CURIOUSX_AVX2)
+    static unsigned stopMask(__m256i v)
+    {
+        const __m256i hit =
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')), _mm256_cmpeq_epi8(v, _mm256_setzero_si256()));
+        return static_cast<unsigned>(_mm256_movemask_epi8(hit));
+    }
+#endif
+};
+
+template <typename Run>
+const char* scalarSkip(const char* p, const char* end)
+{
+    while (p < end && !Run::stops(*p))
+        ++p;
+    return p;
+}
+
+template <typename Run>
+const char* skip(const char* p, const char* end)
+{
+#if defined(CURIOUSX_AVX2)
+    while (end - p >= 32)
+    {
+        const unsigned mask = Run::stopMask(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)));
+        if (mask)
+            return p + std::countr_zero(mask);
+        p += 32;
+    }
+#endif
+#if defined(CURIOUSX_SSE2)
+    while (end - p >= 16)
+    {
+        const unsigned mask = Run::stopMask(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+        if (mask)
+            return p + std::countr_zero(mask);
+        p += 16;
+    }
+#endif
+    return scalarSkip<Run>(p, end);
+}
+} // namespace detail
+
+//! Skips consecutive ' ' characters
+inline const char* skipSpaces(const char* p, const char* end)
+{
+    return detail::skip<detail::SpaceRun>(p, end);
+}
+
+//! Skips identifier and number characters
+inline const char* skipIdentifier(const char* p, const char* end)
+{
+    return detail::skip<detail::IdentRun>(p, end);
+}
+
+//! Skips to the end of the current line (stops at '\n' or '\0')
+inline const char* skipLineBody(const char* p, const char* end)
+{
+    return detail::skip<detail::LineBody>(p, end);
+}
+
+//! Appends the offset (relative to `begin`) just past every '\n' in [begin, end)
+inline void collectLineStarts(const char* begin, const char* end, std::vector<std::uint32_t>& out)
+{
+    const char* p = begin;
+#if defined(CURIOUSX_SSE2)
+    auto emit = [&](const char* block, unsigned mask)
+    {
+        while (mask)
+        {
+            out.push_back(static_cast<std::uint32_t>(block - begin + std::countr_zero(mask) + 1));
+            mask &= mask - 1;
+        }
+    };
+#endif
+#if defined(CURIOUSX_AVX2)
+    const __m256i nl32 = _mm256_set1_epi8('\n');
+    for (; end - p >= 32; p += 32)
+    {
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        emit(p, static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, nl32))));
+    }
+#endif
+#if defined(CURIOUSX_SSE2)
+    const __m128i nl16 = _mm_set1_epi8('\n');
+    for (; end - p >= 16; p += 16)
+    {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        emit(p, static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, nl16))));
+    }
+#endif
+    for (; p < end; ++p)
+    {
+        if (*p == '\n')
+            out.push_back(static_cast<std::uint32_t>(p - begin + 1));
+    }
+}
+
+//! Scalar reference versions of the kernels above, used to cross-check the vector paths
+inline const char* skipSpacesScalar(const char* p, const char* end)
+{
+    return detail::scalarSkip<detail::SpaceRun>(p, end);
+}
+
+inline const char* skipIdentifierScalar(const char* p, const char* end)
+{
+    return detail::scalarSkip<detail::IdentRun>(p, end);
+}
+
+inline const char* skipLineBodyScalar(const char* p, const char* end)
+{
+    return detail::scalarSkip<detail::LineBody>(p, end);
+}
+} // namespace scan
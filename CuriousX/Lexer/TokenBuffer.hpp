@@ -0,0 +1,141 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include "Error.hpp"
+#include "IdentifierTable.hpp"
+#include "LexerToken.hpp"
+
+//! Whole-file token stream stored as parallel arrays (structure of arrays).
+//! Whitespace is dropped at lex time; the last entry is either the Eof token or,
+//! if lexing failed, an Unknown token whose error is available through error().
+//! Once interned, each entry also carries the SymbolId of its variable name.
+class TokenBuffer
+{
+  public:
+    TokenBuffer() = default;
+    explicit TokenBuffer(std::string_view source) : m_source(source) {}
+
+    void reserve(size_t count)
+    {
+        m_types.reserve(count);
+        m_offsets.reserve(count);
+        m_lengths.reserve(count);
+    }
+
+    void push(LexerTokenType type, std::uint32_t offset, std::uint32_t length)
+    {
+        m_types.push_back(type);
+        m_offsets.push_back(offset);
+        m_lengths.push_back(length);
+    }
+
+    //! Terminates the stream with the lexical error raised at `offset`
+    void fail(const Error& error, std::uint32_t offset)
+    {
+        push(LexerTokenType::Unknown, offset, 0);
+        m_error = error;
+    }
+
+    void resize(size_t count)
+    {
+        m_types.resize(count);
+        m_offsets.resize(count);
+        m_lengths.resize(count);
+        m_symbols.clear();
+    }
+
+    //! Gives every variable its ID in `identifiers`. Edits through resize() and splice() drop the
+    //! IDs; the buffer has to be interned again after them.
+    void intern(IdentifierTable& identifiers)
+    {
+        m_symbols.resize(m_types.size());
+        for (size_t i = 0; i < m_types.size(); ++i)
+            m_symbols[i] = m_types[i] == LexerTokenType::VarToken ? identifiers.intern(value(i)) : noSymbol;
+    }
+
+    //! Copies the first `count` entries of `chunk` to position `at`, shifting their offsets by `base`.
+    //! Distinct ranges may be filled concurrently once the buffer has been resized.
+    void place(size_t at, const TokenBuffer& chunk, size_t count, std::uint32_t base)
+    {
+        std::copy_n(chunk.m_types.begin(), count, m_types.begin() + at);
+        std::copy_n(chunk.m_lengths.begin(), count, m_lengths.begin() + at);
+        for (size_t i = 0; i < count; ++i)
+            m_offsets[at + i] = chunk.m_offsets[i] + base;
+    }
+
+    void setError(const Error& error) { m_error = error; }
+    void clearError() { m_error.reset(); }
+
+    //! Points the buffer at an edited copy of its source; offsets must be updated to match
+    void setSource(std::string_view source) { m_source = source; }
+
+    //! Replaces entries [from, to) with every entry of `replacement`
+    void splice(size_t from, size_t to, const TokenBuffer& replacement)
+    {
+        auto replace = [&](auto& into, const auto& with)
+        {
+            into.erase(into.begin() + from, into.begin() + to);
+            into.insert(into.begin() + from, with.begin(), with.end());
+        };
+        replace(m_types, replacement.m_types);
+        replace(m_offsets, replacement.m_offsets);
+        replace(m_lengths, replacement.m_lengths);
+        m_symbols.clear();
+    }
+
+    //! Moves the entries from `from` on by `delta` bytes
+    void shift(size_t from, std::int64_t delta)
+    {
+        for (size_t i = from; i < m_offsets.size(); ++i)
+            m_offsets[i] = static_cast<std::uint32_t>(m_offsets[i] + delta);
+    }
+
+    //! Index of the first entry starting at or after `offset`
+    size_t lowerBound(std::uint32_t offset) const
+    {
+        return static_cast<size_t>(std::lower_bound(m_offsets.begin(), m_offsets.end(), offset) - m_offsets.begin());
+    }
+
+    size_t size() const { return m_types.size(); }
+    bool   empty() const { return m_types.empty(); }
+
+    LexerTokenType type(size_t i) const { return m_types[i]; }
+    std::uint32_t  offset(size_t i) const { return m_offsets[i]; }
+    std::uint32_t  length(size_t i) const { return m_lengths[i]; }
+
+    std::string_view value(size_t i) const
+    {
+        switch (m_types[i])
+        {
+        case LexerTokenType::Newline:
+            return "\\n";
+        case LexerTokenType::Eof:
+            return "";
+        default:
+            return m_source.substr(m_offsets[i], m_lengths[i]);
+        }
+    }
+
+    //! Materializes entry `i` as a LexerToken
+    LexerToken token(size_t i) const
+    {
+        return {value(i), m_offsets[i], m_types[i], m_symbols.empty() ? noSymbol : m_symbols[i],
+                static_cast<std::uint32_t>(i)};
+    }
+
+    const std::optional<Error>& error() const { return m_error; }
+    std::string_view            source() const { return m_source; }
+
+  private:
+    std::string_view            m_source;
+    std::vector<LexerTokenType> m_types;
+    std::vector<std::uint32_t>  m_offsets;
+    std::vector<std::uint32_t>  m_lengths;
+    std::vector<SymbolId>       m_symbols; // empty until intern()
+    std::optional<Error>        m_error;
+};
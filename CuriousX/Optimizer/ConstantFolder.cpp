@@ -0,0 +1,272 @@
+#include "ConstantFolder.hpp"
+#include <bit>
+#include <charconv>
+#include <cmath>
+#include <limits>
+
+// Host float arithmetic stands in for f32 instructions, so it has to be IEEE single precision
+static_assert(std::numeric_limits<float>::is_iec559);
+
+void ConstantFolder::emit(const BinaryNode& node)
+{
+    std::optional<Constant> value;
+    const BinaryNode*       literal = nullptr;
+    switch (node.token.type)
+    {
+    case LexerTokenType::IntToken:
+    case LexerTokenType::FloatToken:
+    case LexerTokenType::BoolToken:
+        value   = literalValue(node);
+        literal = &node;
+        break;
+    case LexerTokenType::VarToken:
+    {
+        const SymbolId id = m_symbols.idOf(node.token);
+        if (id < m_values.size())
+            value = m_values[id];
+        break;
+    }
+    default:
+        // Held operands are always the top of the stack, so the two of an operation are the last two
+        if (m_held.size() >= 2)
+            value = fold(node.token.type, m_held[m_held.size() - 2].value, m_held.back().value);
+        if (value)
+            m_held.resize(m_held.size() - 2);
+        break;
+    }
+
+    if (value)
+        return m_held.push_back({*value, literal});
+    flush();
+    m_codegen.emit(node);
+}
+
+void ConstantFolder::emitAssignment(const LexerToken& variable)
+{
+    // The value assigned is the top of the stack
+    std::optional<Constant> value;
+    if (!m_held.empty())
+        value = m_held.back().value;
+    flush();
+    assign(m_symbols.idOf(variable), value);
+    m_codegen.emitAssignment(variable);
+}
+
+void ConstantFolder::emitIf()
+{
+    flush();
+    m_codegen.emitIf();
+    m_branches.push_back({m_undo.size(), {}});
+}
+
+void ConstantFolder::emitElse()
+{
+    flush();
+    // The else branch starts from the values known before the conditional too
+    undoTo(m_branches.back().mark, m_branches.back().assigned);
+    m_codegen.emitElse();
+}
+
+void ConstantFolder::emitEnd()
+{
+    flush();
+    auto branch = std::move(m_branches.back());
+    m_branches.pop_back();
+    undoTo(branch.mark, branch.assigned);
+    // Which branch ran is not known, so neither value is; an enclosing branch can undo this as well
+    for (auto variable : branch.assigned)
+        assign(variable, std::nullopt);
+    m_codegen.emitEnd();
+}
+
+void ConstantFolder::emitPrint()
+{
+    flush();
+    m_codegen.emitPrint();
+}
+
+void ConstantFolder::endStatement()
+{
+    flush();
+    m_undo.clear();
+}
+
+void ConstantFolder::discardStatement()
+{
+    m_held.clear();
+    m_branches.clear();
+    std::vector<SymbolId> undone;
+    undoTo(0, undone);
+}
+
+void ConstantFolder::flush()
+{
+    for (const auto& held : m_held)
+    {
+        if (held.literal)
+            m_codegen.emit(*held.literal);
+        else
+            m_codegen.emitConstant(held.value.type, format(held.value));
+    }
+    m_held.clear();
+}
+
+void ConstantFolder::assign(SymbolId variable, std::optional<Constant> value)
+{
+    if (variable >= m_values.size())
+        m_values.resize(variable + 1);
+    m_undo.emplace_back(variable, m_values[variable]);
+    m_values[variable] = value;
+}
+
+void ConstantFolder::undoTo(size_t mark, std::vector<SymbolId>& undone)
+{
+    for (; m_undo.size() > mark; m_undo.pop_back())
+    {
+        m_values[m_undo.back().first] = m_undo.back().second;
+        undone.push_back(m_undo.back().first);
+    }
+}
+
+std::optional<ConstantFolder::Constant> ConstantFolder::literalValue(const BinaryNode& node)
+{
+    const auto  text = node.token.value;
+    const char* end  = text.data() + text.size();
+    switch (node.token.type)
+    {
+    case LexerTokenType::IntToken:
+    {
+        // i32.const takes 0 to 2^32 - 1, the top half standing for negative values
+        std::uint64_t value  = 0;
+        const auto    parsed = std::from_chars(text.data(), end, value);
+        if (parsed.ec != std::errc{} || parsed.ptr != end || value > std::numeric_limits<std::uint32_t>::max())
+            return std::nullopt;
+        return Constant{InferredType::INTEGER, static_cast<std::uint32_t>(value)};
+    }
+    case LexerTokenType::FloatToken:
+    {
+        // Rounded to the nearest float, as f32.const rounds its literal
+        float      value  = 0;
+        const auto parsed = std::from_chars(text.data(), end, value);
+        if (parsed.ec != std::errc{} || parsed.ptr != end)
+            return std::nullopt;
+        return Constant{InferredType::FLOAT, std::bit_cast<std::uint32_t>(value)};
+    }
+    case LexerTokenType::BoolToken:
+        return Constant{InferredType::BOOL, text == "true"};
+    default:
+        return std::nullopt;
+    }
+}
+
+std::optional<ConstantFolder::Constant>
+ConstantFolder::fold(LexerTokenType operation, Constant left, Constant right)
+{
+    if (left.type != right.type)
+        return std::nullopt;
+    auto boolean = [](bool value) { return Constant{InferredType::BOOL, value}; };
+
+    if (left.type == InferredType::INTEGER)
+    {
+        // Unsigned arithmetic wraps around exactly as i32.add, i32.sub and i32.mul do
+        const std::uint32_t a = left.bits, b = right.bits;
+        const auto          sa = static_cast<std::int32_t>(a), sb = static_cast<std::int32_t>(b);
+        auto                integer = [](std::uint32_t value) { return Constant{InferredType::INTEGER, value}; };
+        switch (operation)
+        {
+        case LexerTokenType::PlusToken:
+            return integer(a + b);
+        case LexerTokenType::MinusToken:
+            return integer(a - b);
+        case LexerTokenType::MultiplyToken:
+            return integer(a * b);
+        case LexerTokenType::DivideToken:
+            // i32.div_s traps on these, which has to happen at run time
+            if (b == 0 || (sa == std::numeric_limits<std::int32_t>::min() && sb == -1))
+                return std::nullopt;
+            return integer(static_cast<std::uint32_t>(sa / sb));
+        case LexerTokenType::EqualToken:
+            return boolean(a == b);
+        case LexerTokenType::NotEqualToken:
+            return boolean(a != b);
+        case LexerTokenType::LessToken:
+            return boolean(sa < sb);
+        case LexerTokenType::LessEqualToken:
+            return boolean(sa <= sb);
+        case LexerTokenType::GreaterToken:
+            return boolean(sa > sb);
+        case LexerTokenType::GreaterEqualToken:
+            return boolean(sa >= sb);
+        default:
+            return std::nullopt;
+        }
+    }
+
+    if (left.type == InferredType::FLOAT)
+    {
+        const auto x = std::bit_cast<float>(left.bits), y = std::bit_cast<float>(right.bits);
+        float      result;
+        switch (operation)
+        {
+        case LexerTokenType::PlusToken:
+            result = x + y;
+            break;
+        case LexerTokenType::MinusToken:
+            result = x - y;
+            break;
+        case LexerTokenType::MultiplyToken:
+            result = x * y;
+            break;
+        case LexerTokenType::DivideToken:
+            if (y == 0)
+                return std::nullopt;
+            result = x / y;
+            break;
+        case LexerTokenType::EqualToken:
+            return boolean(x == y);
+        case LexerTokenType::NotEqualToken:
+            return boolean(x != y);
+        case LexerTokenType::LessToken:
+            return boolean(x < y);
+        case LexerTokenType::LessEqualToken:
+            return boolean(x <= y);
+        case LexerTokenType::GreaterToken:
+            return boolean(x > y);
+        case LexerTokenType::GreaterEqualToken:
+            return boolean(x >= y);
+        default:
+            return std::nullopt;
+        }
+        // A NaN's bits differ between engines, and neither it nor an infinity is written as a number
+        if (!std::isfinite(result))
+            return std::nullopt;
+        return Constant{InferredType::FLOAT, std::bit_cast<std::uint32_t>(result)};
+    }
+
+    if (left.type == InferredType::BOOL && operation == LexerTokenType::EqualToken)
+        return boolean(left.bits == right.bits);
+    if (left.type == InferredType::BOOL && operation == LexerTokenType::NotEqualToken)
+        return boolean(left.bits != right.bits);
+    return std::nullopt;
+}
+
+std::string ConstantFolder::format(Constant constant)
+{
+    switch (constant.type)
+    {
+    case InferredType::INTEGER:
+        return std::to_string(static_cast<std::int32_t>(constant.bits));
+    case InferredType::BOOL:
+        return constant.bits ? "true" : "false";
+    default:
+    {
+        // The shortest digits that read back as the same float, written the way float literals are
+        char       digits[32];
+        const auto written = std::to_chars(digits, digits + sizeof(digits), std::bit_cast<float>(constant.bits));
+        std::string text(digits, written.ptr);
+        if (text.find_first_of(".e") == std::string::npos)
+            text += ".0";
+        return text;
+    }
+    }
+}
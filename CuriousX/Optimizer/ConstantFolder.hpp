@@ -0,0 +1,82 @@
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////
+/// Constant folding and propagation, between Semantic and WasmGen
+/// (CompilerOptions::foldConstants). The folder receives a statement's
+/// code in the order WasmGen would emit it and passes it on, except for
+/// values it can compute: int, float and bool literals, variables last
+/// assigned such a value, and operations over them. These are held back,
+/// and an operation on two held values becomes one constant, computed as
+/// the wasm instruction would compute it: i32 arithmetic wraps around and
+/// f32 arithmetic rounds to single precision. Operations that trap, or
+/// that would produce a NaN or an infinity, are left to run. A held value
+/// is emitted once something needs it on the wasm stack.
+///
+/// Variable values flow through straight-line code, across statements.
+/// Each branch of a conditional starts from the values known before it,
+/// and a variable that either branch assigns is unknown after it.
+///////////////////////////////////////////////////////////////////////////
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Codegen.hpp"
+
+class ConstantFolder : public CodeEmitter
+{
+  public:
+    //! Passes the remaining code on to `codegen`. Variables are identified through `symbols`; both must
+    //! outlive the folder.
+    ConstantFolder(WasmGen& codegen, ScopedSymbolTable& symbols) : m_codegen(codegen), m_symbols(symbols) {}
+
+    void emit(const BinaryNode& node) override;
+    void emitAssignment(const LexerToken& variable) override;
+    void emitIf() override;
+    void emitElse() override;
+    void emitEnd() override;
+    void emitPrint() override;
+
+    //! Emits the values a complete top-level statement left held back
+    void endStatement();
+    //! Forgets a statement that failed part way: the values it held back and those it assigned
+    void discardStatement();
+
+  private:
+    //! A value known at compile time: the bits of an i32 or f32, or 0 and 1 for BOOL
+    struct Constant
+    {
+        InferredType  type;
+        std::uint32_t bits;
+    };
+    //! An operand held back from the wasm stack
+    struct Held
+    {
+        Constant          value;
+        const BinaryNode* literal; // literal it was written as, emitted unchanged; null once computed
+    };
+    struct Branch
+    {
+        size_t                mark;     // undo log length when the conditional began
+        std::vector<SymbolId> assigned; // variables assigned by the branches finished so far
+    };
+
+    static std::optional<Constant> literalValue(const BinaryNode& node);
+    static std::optional<Constant> fold(LexerTokenType operation, Constant left, Constant right);
+    static std::string             format(Constant constant);
+
+    //! Emits every held operand, deepest first
+    void flush();
+    void assign(SymbolId variable, std::optional<Constant> value);
+    //! Restores the values from before the undo log reached `mark`, adding the variables to `undone`
+    void undoTo(size_t mark, std::vector<SymbolId>& undone);
+
+    WasmGen&                                                  m_codegen;
+    ScopedSymbolTable&                                        m_symbols;
+    std::vector<Held>                                         m_held; // always the top of the wasm stack
+    std::vector<std::optional<Constant>>                      m_values; // value of each variable by SymbolId
+    std::vector<std::pair<SymbolId, std::optional<Constant>>> m_undo;   // earlier values, this statement
+    std::vector<Branch>                                       m_branches; // conditionals being emitted
+};
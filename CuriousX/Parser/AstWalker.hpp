@@ -0,0 +1,133 @@
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////
+/// Depth-first traversal of ASTNode trees on an explicit stack.
+/// Expression trees grow as deep as the longest operator chain in the
+/// source, so passes over them must not recurse on the call stack; they
+/// walk the tree with an AstWalker instead. Its frame stack is kept
+/// between walks, so a pass allocates only while a tree is deeper than
+/// any it has seen before.
+///
+/// Children are visited left to right in the order FlatAST stores them:
+///   BinaryOperation       left, right
+///   ConditionalOperation  condition, if, else
+///   BlockOperation        one child per statement
+/// Missing children are skipped.
+///////////////////////////////////////////////////////////////////////////
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "Node.hpp"
+
+//! Number of child slots of `node`, including empty ones
+inline size_t childCount(const ASTNode& node)
+{
+    switch (node.getType())
+    {
+    case NodeType::BinaryOperation:
+        return 2;
+    case NodeType::ConditionalOperation:
+        return 3;
+    case NodeType::BlockOperation:
+        return static_cast<const TreeNode&>(node).children.size();
+    }
+    return 0;
+}
+
+//! Child slot `index` of `node`; null when the slot is empty
+inline const ASTNode* childAt(const ASTNode& node, size_t index)
+{
+    switch (node.getType())
+    {
+    case NodeType::BinaryOperation:
+    {
+        const auto& binary = static_cast<const BinaryNode&>(node);
+        return index == 0 ? binary.left : binary.right;
+    }
+    case NodeType::ConditionalOperation:
+    {
+        const auto& conditional = static_cast<const ConditionalNode&>(node);
+        if (index == 0)
+            return conditional.condition;
+        return index == 1 ? conditional.ifNode : conditional.elseNode;
+    }
+    case NodeType::BlockOperation:
+        return static_cast<const TreeNode&>(node).children[index];
+    }
+    return nullptr;
+}
+
+class AstWalker
+{
+  public:
+    //! Walks the tree under `root`. `enter(node)` runs before a node's children and returns whether
+    //! to visit them; `leave(node)` runs after them, for every entered node. Walks may nest: a
+    //! callback can start another walk on the same walker.
+    template <typename Enter, typename Leave>
+    void walk(const ASTNode& root, Enter&& enter, Leave&& leave)
+    {
+        const size_t base  = m_frames.size();
+        const bool   outer = std::exchange(m_stopped, false);
+#if !defined(CURIOUSX_NO_EXCEPTIONS)
+        try
+        {
+#endif
+            push(root, enter);
+            while (m_frames.size() > base && !m_stopped)
+            {
+                // Callbacks may grow the stack, so the frame is re-read after each of them
+                const ASTNode* node = m_frames.back().node;
+                if (m_frames.back().next < m_frames.back().count)
+                {
+                    const ASTNode* child = childAt(*node, m_frames.back().next++);
+                    if (child)
+                        push(*child, enter);
+                    continue;
+                }
+                m_frames.pop_back();
+                leave(*node);
+            }
+#if !defined(CURIOUSX_NO_EXCEPTIONS)
+        }
+        catch (...)
+        {
+            // A failed walk leaves nothing behind for the next one
+            m_frames.resize(base);
+            m_stopped = outer;
+            throw;
+        }
+#endif
+        m_frames.resize(base);
+        m_stopped = outer;
+    }
+
+    //! Ends the current walk once the running callback returns; no further callbacks run for it
+    void stop() { m_stopped = true; }
+
+    //! Post-order walk: `visit(node)` runs after the children of every node
+    template <typename Visit>
+    void postOrder(const ASTNode& root, Visit&& visit)
+    {
+        walk(root, [](const ASTNode&) { return true; }, visit);
+    }
+
+  private:
+    struct Frame
+    {
+        const ASTNode* node;
+        size_t         next;  // next child slot to visit
+        size_t         count; // child slots to visit; 0 when enter() declined them
+    };
+
+    template <typename Enter>
+    void push(const ASTNode& node, Enter& enter)
+    {
+        const bool descend = enter(node);
+        m_frames.push_back({&node, 0, descend ? childCount(node) : 0});
+    }
+
+    std::vector<Frame> m_frames;
+    bool               m_stopped = false;
+};
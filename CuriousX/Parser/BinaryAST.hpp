@@ -0,0 +1,322 @@
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////
+/// Versioned binary form of the AST, for tools that post-process ASTs
+/// without parsing JSON or recompiling. The writer encodes the nodes of a
+/// FlatAST in post-order, so the last node is the root. The reader works on the encoded bytes in place, for example on
+/// a memory-mapped SourceFile: it validates and indexes them once, token
+/// values are string_views into the bytes and child lists are decoded on
+/// demand.
+///
+/// Layout, version 1. Integers are unsigned LEB128 varints unless a size
+/// is given:
+///   magic         4 bytes "CXAB"
+///   version       1 byte
+///   strings       count, then per string: length, bytes
+///   nodes         count, then per node:
+///     kind          1 byte, NodeType
+///     token type    1 byte, LexerTokenType
+///     value         index into the strings
+///     line          zigzag difference from the previous node's line; line 0 means no position
+///     column
+///     children      count, then per child slot: 0 when empty, otherwise
+///                   how many nodes before this one the child is
+///////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "Expected.hpp"
+#include "FlatAST.hpp"
+#include "LineIndex.hpp"
+
+namespace binaryAST
+{
+inline constexpr std::string_view magic   = "CXAB";
+inline constexpr std::uint8_t     version = 1;
+
+inline void putVarint(std::string& out, std::uint64_t value)
+{
+    for (; value >= 0x80; value >>= 7)
+        out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+    out.push_back(static_cast<char>(value));
+}
+
+//! Reads a varint at `pos` and moves past it; false when the bytes end first or it does not fit 32 bits
+inline bool getVarint(std::string_view bytes, size_t& pos, std::uint32_t& value)
+{
+    std::uint64_t result = 0;
+    for (unsigned shift = 0; pos < bytes.size() && shift < 35; shift += 7)
+    {
+        const auto byte = static_cast<std::uint8_t>(bytes[pos++]);
+        result |= std::uint64_t{byte & 0x7fu} << shift;
+        if (!(byte & 0x80))
+        {
+            value = static_cast<std::uint32_t>(result);
+            return result <= UINT32_MAX;
+        }
+    }
+    return false;
+}
+} // namespace binaryAST
+
+class BinaryASTWriter
+{
+  public:
+    //! Token offsets are turned into lines and columns with `lines`
+    explicit BinaryASTWriter(const LineIndex& lines) : m_lines(lines) {}
+
+    //! Encodes the nodes of `ast` up to `root`, which has to be the last of them
+    std::string write(const FlatAST& ast, FlatAST::NodeId root)
+    {
+        std::string                                         nodes;
+        std::vector<std::string_view>                       strings;
+        std::unordered_map<std::string_view, std::uint32_t> stringIds;
+        std::uint32_t                                       previousLine = 0;
+        size_t                                              written      = 0;
+
+        // One node per occurrence, so a FlatAST that shares subtrees encodes as one that does not
+        std::vector<std::uint32_t> finished; // occurrences whose parent is not written yet
+        binaryAST::putVarint(nodes, ast.occurrences(root));
+        ast.forEachOccurrence(
+            root,
+            [&](FlatAST::NodeId id, const LexerToken& token)
+            {
+                const auto [string, created] = stringIds.try_emplace(token.value, strings.size());
+                if (created)
+                    strings.push_back(token.value);
+                const auto location = m_lines.locate(token.offset);
+                const auto lineStep = static_cast<std::int64_t>(location.getLine()) - previousLine;
+                previousLine        = location.getLine();
+
+                nodes.push_back(static_cast<char>(ast.kind(id)));
+                nodes.push_back(static_cast<char>(token.type));
+                binaryAST::putVarint(nodes, string->second);
+                binaryAST::putVarint(nodes, static_cast<std::uint64_t>((lineStep << 1) ^ (lineStep >> 63)));
+                binaryAST::putVarint(nodes, location.getCol());
+
+                const auto children = ast.children(id);
+                const auto present  = static_cast<size_t>(std::count_if(
+                    children.begin(), children.end(), [](FlatAST::NodeId child) { return child != FlatAST::none; }));
+                const auto occurrence = static_cast<std::uint32_t>(written++);
+                auto       next       = finished.end() - static_cast<std::ptrdiff_t>(present);
+                binaryAST::putVarint(nodes, children.size());
+                for (auto child : children)
+                    binaryAST::putVarint(nodes, child == FlatAST::none ? 0 : occurrence - *next++);
+                finished.resize(finished.size() - present);
+                finished.push_back(occurrence);
+            });
+
+        std::string out(binaryAST::magic);
+        out.push_back(static_cast<char>(binaryAST::version));
+        binaryAST::putVarint(out, strings.size());
+        for (auto string : strings)
+        {
+            binaryAST::putVarint(out, string.size());
+            out += string;
+        }
+        return out + nodes;
+    }
+
+  private:
+    const LineIndex& m_lines;
+};
+
+class BinaryASTReader
+{
+  public:
+    using NodeId = FlatAST::NodeId;
+
+    //! Child slots of one node in FlatAST's layout, decoded from the bytes as they are iterated;
+    //! FlatAST::none marks an empty slot
+    class Children
+    {
+      public:
+        class iterator
+        {
+          public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type        = NodeId;
+            using difference_type   = std::ptrdiff_t;
+            using pointer           = const NodeId*;
+            using reference         = NodeId;
+
+            iterator() = default;
+
+            NodeId    operator*() const { return m_child; }
+            iterator& operator++()
+            {
+                --m_left;
+                decode();
+                return *this;
+            }
+            iterator operator++(int)
+            {
+                iterator before = *this;
+                ++*this;
+                return before;
+            }
+            //! Only iterators of the same Children compare meaningfully
+            bool operator==(const iterator& other) const { return m_left == other.m_left; }
+
+          private:
+            friend class Children;
+
+            iterator(std::string_view bytes, size_t pos, NodeId parent, std::uint32_t left)
+                : m_bytes(bytes), m_pos(pos), m_parent(parent), m_left(left)
+            {
+                decode();
+            }
+
+            // The reader checked every slot when it opened the bytes
+            void decode()
+            {
+                std::uint32_t back = 0;
+                if (m_left > 0 && binaryAST::getVarint(m_bytes, m_pos, back))
+                    m_child = back == 0 ? FlatAST::none : m_parent - back;
+            }
+
+            std::string_view m_bytes;
+            size_t           m_pos    = 0;
+            NodeId           m_parent = 0;
+            NodeId           m_child  = FlatAST::none;
+            std::uint32_t    m_left   = 0; // slots from this one to the end
+        };
+
+        iterator begin() const { return iterator(m_bytes, m_pos, m_parent, m_count); }
+        iterator end() const { return {}; }
+        size_t   size() const { return m_count; }
+
+      private:
+        friend class BinaryASTReader;
+
+        Children(std::string_view bytes, size_t pos, NodeId parent) : m_bytes(bytes), m_pos(pos), m_parent(parent)
+        {
+            binaryAST::getVarint(m_bytes, m_pos, m_count);
+        }
+
+        std::string_view m_bytes;
+        size_t           m_pos;
+        NodeId           m_parent;
+        std::uint32_t    m_count = 0;
+    };
+
+    //! Checks and indexes `bytes`, which must outlive the reader. Malformed input is described in the
+    //! returned error.
+    static Expected<BinaryASTReader, std::string> open(std::string_view bytes)
+    {
+        BinaryASTReader reader(bytes);
+        if (auto problem = reader.index(); !problem.empty())
+            return Unexpected(std::move(problem));
+        return reader;
+    }
+
+    size_t size() const { return m_nodes.size(); }
+    NodeId root() const { return static_cast<NodeId>(m_nodes.size() - 1); }
+
+    NodeType       kind(NodeId id) const { return static_cast<NodeType>(m_bytes[m_nodes[id].record]); }
+    LexerTokenType tokenType(NodeId id) const
+    {
+        return static_cast<LexerTokenType>(m_bytes[m_nodes[id].record + 1]);
+    }
+    std::string_view value(NodeId id) const { return m_strings[m_nodes[id].value]; }
+    SourceLocation   location(NodeId id) const { return SourceLocation(m_nodes[id].line, m_nodes[id].column); }
+
+    //! Child slots of `id`, read from the bytes without copying them out
+    Children children(NodeId id) const { return Children(m_bytes, m_nodes[id].children, id); }
+
+  private:
+    struct Node
+    {
+        std::uint32_t record;   // offset of the kind byte
+        std::uint32_t children; // offset of the child count
+        std::uint32_t value;
+        std::uint32_t line;
+        std::uint32_t column;
+    };
+
+    explicit BinaryASTReader(std::string_view bytes) : m_bytes(bytes) {}
+
+    // Walks the whole encoding once; returns what is wrong with it, or nothing
+    std::string index()
+    {
+        if (!m_bytes.starts_with(binaryAST::magic) || m_bytes.size() <= binaryAST::magic.size())
+            return "Not a CuriousX binary AST";
+        if (static_cast<std::uint8_t>(m_bytes[binaryAST::magic.size()]) != binaryAST::version)
+            return "Unsupported binary AST version " +
+                   std::to_string(static_cast<std::uint8_t>(m_bytes[binaryAST::magic.size()]));
+
+        size_t        pos = binaryAST::magic.size() + 1;
+        std::uint32_t count = 0, length = 0;
+        if (!binaryAST::getVarint(m_bytes, pos, count) || count > m_bytes.size() - pos)
+            return "Truncated string table";
+        m_strings.reserve(count);
+        for (std::uint32_t i = 0; i < count; ++i)
+        {
+            if (!binaryAST::getVarint(m_bytes, pos, length) || length > m_bytes.size() - pos)
+                return "Truncated string table";
+            m_strings.push_back(m_bytes.substr(pos, length));
+            pos += length;
+        }
+
+        if (!binaryAST::getVarint(m_bytes, pos, count) || count == 0 || count > m_bytes.size() - pos)
+            return "Missing nodes";
+        m_nodes.reserve(count);
+        std::uint32_t line = 0;
+        for (NodeId id = 0; id < count; ++id)
+        {
+            if (m_bytes.size() - pos < 2)
+                return "Truncated node " + std::to_string(id);
+            Node          node{static_cast<std::uint32_t>(pos), 0, 0, 0, 0};
+            const auto    kind = static_cast<std::uint8_t>(m_bytes[pos]);
+            const auto    type = static_cast<std::uint8_t>(m_bytes[pos + 1]);
+            std::uint32_t value = 0, lineStep = 0, column = 0, children = 0, back = 0;
+            pos += 2;
+            if (kind > static_cast<std::uint8_t>(NodeType::BlockOperation) ||
+                type > static_cast<std::uint8_t>(LexerTokenType::Unknown))
+                return "Invalid kind of node " + std::to_string(id);
+            if (!binaryAST::getVarint(m_bytes, pos, value) || !binaryAST::getVarint(m_bytes, pos, lineStep) ||
+                !binaryAST::getVarint(m_bytes, pos, column) || value >= m_strings.size())
+                return "Invalid token of node " + std::to_string(id);
+            line += (lineStep >> 1) ^ (0u - (lineStep & 1));
+            node.value    = value;
+            node.line     = line;
+            node.column   = column;
+            node.children = static_cast<std::uint32_t>(pos);
+
+            if (!binaryAST::getVarint(m_bytes, pos, children) || !validChildCount(kind, children))
+                return "Invalid children of node " + std::to_string(id);
+            for (std::uint32_t i = 0; i < children; ++i)
+                if (!binaryAST::getVarint(m_bytes, pos, back) || back > id)
+                    return "Invalid children of node " + std::to_string(id);
+            m_nodes.push_back(node);
+        }
+        if (pos != m_bytes.size())
+            return "Unexpected bytes after the last node";
+        return {};
+    }
+
+    static bool validChildCount(std::uint8_t kind, std::uint32_t count)
+    {
+        switch (static_cast<NodeType>(kind))
+        {
+        case NodeType::BinaryOperation:
+            return count == 2;
+        case NodeType::ConditionalOperation:
+            return count == 3;
+        case NodeType::BlockOperation:
+            return true;
+        }
+        return false;
+    }
+
+    std::string_view              m_bytes;
+    std::vector<std::string_view> m_strings;
+    std::vector<Node>             m_nodes;
+};
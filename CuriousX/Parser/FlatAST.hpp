@@ -0,0 +1,248 @@
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////
+/// Index-based copy of the AST that the compiler keeps for its output
+/// (the AST section and the binary AST). The passes do not use it; they
+/// walk the pointer tree, which it is copied from.
+/// Every node is a 32-bit id into parallel arrays (kind, token reference,
+/// start of its child range); child ids are stored contiguously in one
+/// array. Nodes are appended in post-order, so a forward sweep over the ids
+/// visits children before their parents and needs neither recursion nor
+/// pointer chasing. Trees are copied in with an AstWalker, so appending
+/// does not recurse either.
+///
+/// With sharing, equal subtrees (see SubtreeTable) are stored once, so
+/// the nodes form a DAG. The token of each occurrence of a node is kept
+/// apart from the node, in the order of a post-order walk over the whole
+/// tree, and forEachOccurrence() hands every occurrence its own token.
+///
+/// Layout of a node's child range:
+///   BinaryOperation       left, right          (none for a missing side)
+///   ConditionalOperation  condition, if, else  (none without else)
+///   BlockOperation        one id per statement
+///////////////////////////////////////////////////////////////////////////
+
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "AstWalker.hpp"
+#include "Node.hpp"
+#include "TokenBuffer.hpp"
+
+class FlatAST
+{
+  public:
+    using NodeId                 = std::uint32_t;
+    static constexpr NodeId none = std::numeric_limits<NodeId>::max();
+
+    //! Tokens that came from `tokens` are stored as indices into it, which must outlive the AST. With
+    //! `shareSubtrees`, equal subtrees are stored once across all appended trees.
+    explicit FlatAST(const TokenBuffer& tokens, bool shareSubtrees = false)
+        : m_tokens(tokens), m_shareSubtrees(shareSubtrees)
+    {
+    }
+
+    //! Copies the tree under `root` and returns the id of its root
+    NodeId append(const ASTNode& root)
+    {
+        m_walker.postOrder(root, [this](const ASTNode& node) { appendNode(node); });
+        const NodeId id = m_pending.back();
+        m_pending.pop_back();
+        return id;
+    }
+
+    //! Adds a block whose statements were appended earlier
+    NodeId addBlock(const LexerToken& token, std::span<const NodeId> children)
+    {
+        return addNode(NodeType::BlockOperation, token, children);
+    }
+
+    //! Drops every node, for when the token buffer moves on to another slice of the input
+    void clear()
+    {
+        m_kinds.clear();
+        m_tokenRefs.clear();
+        m_childBegin.assign(1, 0);
+        m_children.clear();
+        m_useRefs.clear();
+        m_synthetic.clear();
+        m_shared.clear();
+    }
+
+    size_t   size() const { return m_kinds.size(); }
+    bool     empty() const { return m_kinds.empty(); }
+    NodeType kind(NodeId id) const { return m_kinds[id]; }
+
+    //! Token of the node; with sharing, that of its first occurrence
+    LexerToken token(NodeId id) const { return tokenAt(m_tokenRefs[id]); }
+
+    std::span<const NodeId> children(NodeId id) const
+    {
+        return std::span(m_children).subspan(m_childBegin[id], m_childBegin[id + 1] - m_childBegin[id]);
+    }
+
+    //! Number of nodes under `root` counting each occurrence of a shared subtree, as forEachOccurrence()
+    //! visits them
+    size_t occurrences(NodeId root) const { return m_shareSubtrees ? m_useRefs.size() : root + 1; }
+
+    //! Calls `visit(id, token)` for every node under `root`, children first, with the token of that
+    //! occurrence; a shared subtree is visited once for each place it occurs. `root` has to be the last
+    //! node added, with every tree added before it under it.
+    template <typename Visit> void forEachOccurrence(NodeId root, Visit&& visit) const
+    {
+        if (!m_shareSubtrees)
+        {
+            // Without sharing, ids are already in post-order and every node occurs once
+            for (NodeId id = 0; id <= root; ++id)
+                visit(id, token(id));
+            return;
+        }
+
+        // The same walk that added the occurrences, so they come in the order their tokens were stored
+        std::vector<std::pair<NodeId, std::uint32_t>> stack{{root, 0}}; // node, next child slot
+        size_t                                         use = 0;
+        while (!stack.empty())
+        {
+            const auto [id, slot] = stack.back();
+            const auto kids       = children(id);
+            std::uint32_t next    = slot;
+            while (next < kids.size() && kids[next] == none)
+                ++next;
+            if (next < kids.size())
+            {
+                stack.back().second = next + 1;
+                stack.emplace_back(kids[next], 0);
+                continue;
+            }
+            visit(id, tokenAt(m_useRefs[use++]));
+            stack.pop_back();
+        }
+    }
+
+    //! Bytes held by the node arrays
+    size_t memoryUsage() const
+    {
+        return m_kinds.capacity() * sizeof(NodeType) + m_tokenRefs.capacity() * sizeof(std::uint32_t) +
+               m_childBegin.capacity() * sizeof(std::uint32_t) + m_children.capacity() * sizeof(NodeId) +
+               m_useRefs.capacity() * sizeof(std::uint32_t) + m_synthetic.capacity() * sizeof(LexerToken);
+    }
+
+  private:
+    static constexpr std::uint32_t syntheticBit = std::uint32_t{1} << 31;
+
+    // Adds `node` once its children are added; their ids wait on m_pending until then
+    void appendNode(const ASTNode& node)
+    {
+        switch (node.getType())
+        {
+        case NodeType::BinaryOperation:
+        {
+            const auto& binary = static_cast<const BinaryNode&>(node);
+            NodeId      sides[2];
+            sides[1] = popPending(binary.right);
+            sides[0] = popPending(binary.left);
+            m_pending.push_back(binary.hash && m_shareSubtrees ? addShared(binary, sides)
+                                                                : addNode(NodeType::BinaryOperation, node.token, sides));
+            break;
+        }
+        case NodeType::ConditionalOperation:
+        {
+            const auto& conditional = static_cast<const ConditionalNode&>(node);
+            NodeId      parts[3];
+            parts[2] = popPending(conditional.elseNode);
+            parts[1] = popPending(conditional.ifNode);
+            parts[0] = popPending(conditional.condition);
+            m_pending.push_back(addNode(NodeType::ConditionalOperation, node.token, parts));
+            break;
+        }
+        case NodeType::BlockOperation:
+        {
+            const size_t count = static_cast<const TreeNode&>(node).children.size();
+            const NodeId id    = addNode(NodeType::BlockOperation, node.token, std::span(m_pending).last(count));
+            m_pending.resize(m_pending.size() - count);
+            m_pending.push_back(id);
+            break;
+        }
+        }
+    }
+
+    // Id of the added `child`, or none for an empty slot, which the walk skipped
+    NodeId popPending(const ASTNode* child)
+    {
+        if (!child)
+            return none;
+        const NodeId id = m_pending.back();
+        m_pending.pop_back();
+        return id;
+    }
+
+    // The node added earlier for the same subtree, or a new one
+    NodeId addShared(const BinaryNode& node, std::span<const NodeId, 2> sides)
+    {
+        // Equal children ids mean equal subtrees, since they were shared the same way
+        const std::uint32_t ref = tokenRef(node.token);
+        auto                it  = m_shared.find(node.hash);
+        if (it != m_shared.end())
+        {
+            const auto children = this->children(it->second);
+            const auto token    = this->token(it->second);
+            if (token.type == node.token.type && token.value == node.token.value && children[0] == sides[0] &&
+                children[1] == sides[1])
+            {
+                m_useRefs.push_back(ref);
+                return it->second;
+            }
+        }
+        const NodeId id = addNode(NodeType::BinaryOperation, ref, sides);
+        m_shared.emplace(node.hash, id);
+        return id;
+    }
+
+    NodeId addNode(NodeType kind, const LexerToken& token, std::span<const NodeId> children)
+    {
+        return addNode(kind, tokenRef(token), children);
+    }
+
+    NodeId addNode(NodeType kind, std::uint32_t ref, std::span<const NodeId> children)
+    {
+        m_kinds.push_back(kind);
+        m_tokenRefs.push_back(ref);
+        if (m_shareSubtrees)
+            m_useRefs.push_back(ref);
+        m_children.insert(m_children.end(), children.begin(), children.end());
+        m_childBegin.push_back(static_cast<std::uint32_t>(m_children.size()));
+        return static_cast<NodeId>(m_kinds.size() - 1);
+    }
+
+    LexerToken tokenAt(std::uint32_t ref) const
+    {
+        return ref & syntheticBit ? m_synthetic[ref & ~syntheticBit] : m_tokens.token(ref);
+    }
+
+    // Index of the token in the token buffer, or of a copy in m_synthetic for tokens the parser made up or
+    // that were read from an earlier slice of the input
+    std::uint32_t tokenRef(const LexerToken& token)
+    {
+        const std::uint32_t index = token.index;
+        if (index < m_tokens.size() && m_tokens.offset(index) == token.offset && m_tokens.type(index) == token.type)
+            return index;
+        m_synthetic.push_back(token);
+        return static_cast<std::uint32_t>(m_synthetic.size() - 1) | syntheticBit;
+    }
+
+    const TokenBuffer&         m_tokens;
+    std::vector<NodeType>      m_kinds;
+    std::vector<std::uint32_t> m_tokenRefs;
+    std::vector<std::uint32_t> m_childBegin{0}; // node i's children are [m_childBegin[i], m_childBegin[i + 1])
+    std::vector<NodeId>        m_children;
+    std::vector<std::uint32_t> m_useRefs; // with sharing, the token of every occurrence, in post-order
+    std::vector<LexerToken>    m_synthetic;
+    AstWalker                  m_walker;
+    std::vector<NodeId>        m_pending; // roots of appended subtrees whose parent is not yet added
+    bool                       m_shareSubtrees;
+    std::unordered_map<std::uint64_t, NodeId> m_shared; // hash-consed subtrees by their hash
+};
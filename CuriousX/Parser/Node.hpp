@@ -1,82 +1,267 @@
 #pragma once
 
+#include "Arena.hpp"
 #include "Lexer.hpp"
-#include <memory>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
-enum class NodeType
+enum class NodeType : std::uint8_t
 {
     BinaryOperation,
     ConditionalOperation,
     BlockOperation,
 };
 
+//! Nodes live in an Arena and are released with it, never one at a time: children are
+//! non-owning pointers and no destructor ever runs.
 class ASTNode
 {
   public:
     ASTNode(const LexerToken& token) : token(token) {}
-    virtual ~ASTNode()               = default;
     virtual NodeType getType() const = 0;
     LexerToken       token;
+
+  protected:
+    ~ASTNode() = default;
+};
+
+//! Type of a value, as semantic analysis infers it
+enum class InferredType : std::uint8_t
+{
+    INTEGER,
+    FLOAT,
+    STRING,
+    BOOL
 };
 
 class BinaryNode : public ASTNode
 {
   public:
-    BinaryNode(std::unique_ptr<ASTNode> left, std::unique_ptr<ASTNode> right, const LexerToken& token)
-        : ASTNode(token), left(std::move(left)), right(std::move(right))
-    {
-    }
-    NodeType                 getType() const override { return NodeType::BinaryOperation; }
-    std::unique_ptr<ASTNode> left;
-    std::unique_ptr<ASTNode> right;
+    BinaryNode(ASTNode* left, ASTNode* right, const LexerToken& token) : ASTNode(token), left(left), right(right) {}
+    NodeType      getType() const override { return NodeType::BinaryOperation; }
+    ASTNode*      left;
+    ASTNode*      right;
+    std::uint64_t hash = 0; // structural hash of a pure subtree (see SubtreeTable); 0 otherwise
+
+    // Annotations Semantic writes while it analyzes an expression, so later passes read them rather than
+    // infer them again. Comparisons have the type of their operands. Empty on trees not analyzed yet.
+    mutable std::optional<InferredType> type;
+    mutable bool                        readsVariable = false; // whether a variable occurs in the subtree
 };
 
 class TreeNode : public ASTNode
 {
   public:
-    TreeNode(std::vector<std::unique_ptr<ASTNode>> children, const LexerToken& token)
-        : ASTNode(token), children(std::move(children))
+    TreeNode(std::span<ASTNode* const> children, const LexerToken& token) : ASTNode(token), children(children) {}
+    NodeType                  getType() const override { return NodeType::BlockOperation; }
+    std::span<ASTNode* const> children;
+};
+
+class ConditionalNode : public ASTNode
+{
+  public:
+    ConditionalNode(ASTNode* condition, TreeNode* ifNode, TreeNode* elseNode, const LexerToken& token)
+        : ASTNode(token), condition(condition), ifNode(ifNode), elseNode(elseNode)
     {
     }
-    NodeType                              getType() const override { return NodeType::BlockOperation; }
-    std::vector<std::unique_ptr<ASTNode>> children;
+    NodeType  getType() const override { return NodeType::ConditionalOperation; }
+    ASTNode*  condition;
+    TreeNode* ifNode;
+    TreeNode* elseNode;
 };
 
-class ConditionalNode : public ASTNode
+//! Structural hashing of pure subtrees: literals, variables and arithmetic over them. A factory given
+//! a table stamps every pure node with a hash of its structure, so equal subtrees are recognized
+//! without comparing them and built only once (see ASTNodeFactory), and work done for one is reused
+//! for the others. Variables hash together with the number of assignments to them seen so far, so an
+//! assignment invalidates the subtrees that read the variable before it. The hashes do not depend on
+//! addresses and stay comparable until clear() is called.
+//!
+//! Each hash is checked against the subtree it was first given to, as an operator over its operands'
+//! hashes or a leaf's token. A different subtree that hashes the same gets 0 and is not shared, so
+//! two nodes with the same nonzero hash are always equal.
+class SubtreeTable
 {
   public:
-    ConditionalNode(std::unique_ptr<ASTNode>  condition,
-                    std::unique_ptr<TreeNode> ifNode,
-                    std::unique_ptr<TreeNode> elseNode,
-                    const LexerToken&         token)
-        : ASTNode(token), condition(std::move(condition)), ifNode(std::move(ifNode)), elseNode(std::move(elseNode))
+    //! Hash of the node that (`left`, `right`, `token`) would make; 0 if it is not pure
+    std::uint64_t hash(const ASTNode* left, const ASTNode* right, const LexerToken& token)
+    {
+        if (!left && !right)
+        {
+            if (!isLeaf(token.type))
+                return 0;
+            const std::uint64_t count = token.type == LexerTokenType::VarToken ? assignments(token) : 0;
+            std::uint64_t       h     = 0xcbf29ce484222325 ^ static_cast<std::uint64_t>(token.type);
+            for (char c : token.value)
+                h = (h ^ static_cast<unsigned char>(c)) * 0x100000001b3;
+            if (token.type == LexerTokenType::VarToken)
+                h ^= mix(count + 1);
+            return checked(nonZero(mix(h)), token.type, count, 0, token.value);
+        }
+        const std::uint64_t l = hashOf(left), r = hashOf(right);
+        if (!l || !r || !isArithmetic(token.type))
+            return 0;
+        return checked(nonZero(mix(mix(static_cast<std::uint64_t>(token.type) + l) ^ (r * 0x9e3779b97f4a7c15))),
+                       token.type, l, r);
+    }
+
+    //! Forgets which subtree each hash was given to, which holds views of leaf tokens, before the source
+    //! they point into goes away. Hashes handed out before may be given to other subtrees afterwards.
+    //! Assignment counts are kept.
+    void clear() { m_subtrees.clear(); }
+
+    //! Records an assignment to `variable`; later reads of it hash differently from earlier ones
+    void assigned(const LexerToken& variable)
+    {
+        if (variable.symbol != noSymbol)
+        {
+            if (variable.symbol >= m_assignmentsById.size())
+                m_assignmentsById.resize(variable.symbol + 1);
+            ++m_assignmentsById[variable.symbol];
+            return;
+        }
+        auto it = m_assignmentsByName.find(variable.value);
+        if (it == m_assignmentsByName.end())
+            it = m_assignmentsByName.emplace(variable.value, 0).first;
+        ++it->second;
+    }
+
+  private:
+    static bool isLeaf(LexerTokenType type)
+    {
+        return type == LexerTokenType::IntToken || type == LexerTokenType::FloatToken ||
+               type == LexerTokenType::StringToken || type == LexerTokenType::BoolToken ||
+               type == LexerTokenType::VarToken;
+    }
+    static bool isArithmetic(LexerTokenType type)
+    {
+        return type == LexerTokenType::PlusToken || type == LexerTokenType::MinusToken ||
+               type == LexerTokenType::MultiplyToken || type == LexerTokenType::DivideToken;
+    }
+    static std::uint64_t hashOf(const ASTNode* node)
+    {
+        if (!node || node->getType() != NodeType::BinaryOperation)
+            return 0;
+        return static_cast<const BinaryNode*>(node)->hash;
+    }
+    static std::uint64_t mix(std::uint64_t h)
+    {
+        h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9;
+        h = (h ^ (h >> 27)) * 0x94d049bb133111eb;
+        return h ^ (h >> 31);
+    }
+    static std::uint64_t nonZero(std::uint64_t h) { return h ? h : 1; }
+
+    //! What a hash was first given to: an operator over its operands' hashes, or a leaf's token and,
+    //! for a variable, its assignment count
+    struct Subtree
     {
+        LexerTokenType   type;
+        std::uint64_t    left;
+        std::uint64_t    right;
+        std::string_view value; // into the source, hence clear()
+    };
+
+    //! `h` if it is new or was first given to the same subtree; 0 if another subtree has it
+    std::uint64_t checked(std::uint64_t h, LexerTokenType type, std::uint64_t left, std::uint64_t right,
+                          std::string_view value = {})
+    {
+        auto it = m_subtrees.find(h);
+        if (it == m_subtrees.end())
+        {
+            m_subtrees.emplace(h, Subtree{type, left, right, value});
+            return h;
+        }
+        const Subtree& first = it->second;
+        return first.type == type && first.left == left && first.right == right && first.value == value ? h : 0;
+    }
+
+    std::uint64_t assignments(const LexerToken& variable) const
+    {
+        if (variable.symbol != noSymbol)
+            return variable.symbol < m_assignmentsById.size() ? m_assignmentsById[variable.symbol] : 0;
+        auto it = m_assignmentsByName.find(variable.value);
+        return it == m_assignmentsByName.end() ? 0 : it->second;
     }
-    NodeType                  getType() const override { return NodeType::ConditionalOperation; }
-    std::unique_ptr<ASTNode>  condition;
-    std::unique_ptr<TreeNode> ifNode;
-    std::unique_ptr<TreeNode> elseNode;
+
+    // Looks names up by string_view, without building a std::string for each read
+    struct NameHash
+    {
+        using is_transparent = void;
+        size_t operator()(std::string_view name) const { return std::hash<std::string_view>{}(name); }
+    };
+
+    std::unordered_map<std::uint64_t, Subtree> m_subtrees;
+    std::vector<std::uint64_t>                 m_assignmentsById; // by SymbolId, for tokens of an interned TokenBuffer
+    std::unordered_map<std::string, std::uint64_t, NameHash, std::equal_to<>> m_assignmentsByName; // the others
 };
 
+//! Creates nodes in the arena it was given; the tree lives exactly as long as that arena's contents.
+//! With a SubtreeTable, pure nodes are stamped with their structural hash, and with `shareNodes` a
+//! pure subtree equal to one made earlier in the same arena is that node again rather than a copy.
+//! The trees are then DAGs, and a shared node has the token of the subtree's first occurrence.
 class ASTNodeFactory
 {
   public:
-    static std::unique_ptr<BinaryNode>
-    createBinaryNode(std::unique_ptr<ASTNode> left, std::unique_ptr<ASTNode> right, const LexerToken& token)
+    explicit ASTNodeFactory(Arena& arena, SubtreeTable* subtrees = nullptr, bool shareNodes = true)
+        : m_arena(&arena), m_subtrees(subtrees), m_shareNodes(shareNodes), m_resets(arena.resetCount())
+    {
+    }
+
+    BinaryNode* createBinaryNode(ASTNode* left, ASTNode* right, const LexerToken& token)
     {
-        return std::make_unique<BinaryNode>(std::move(left), std::move(right), token);
+        if (!m_subtrees)
+            return m_arena->create<BinaryNode>(left, right, token);
+        const std::uint64_t hash = m_subtrees->hash(left, right, token);
+        if (token.type == LexerTokenType::AssignToken && left && left->token.type == LexerTokenType::VarToken)
+            m_subtrees->assigned(left->token);
+        if (!hash || !m_shareNodes)
+            return create(left, right, token, hash);
+
+        // The nodes of an arena that was reset since are gone
+        if (m_resets != m_arena->resetCount())
+        {
+            m_nodes.clear();
+            m_resets = m_arena->resetCount();
+        }
+        auto [node, created] = m_nodes.try_emplace(hash, nullptr);
+        if (created)
+            node->second = create(left, right, token, hash);
+        return node->second;
     }
-    static std::unique_ptr<ASTNode> createConditionalNode(std::unique_ptr<ASTNode>  condition,
-                                                          std::unique_ptr<TreeNode> ifNode,
-                                                          std::unique_ptr<TreeNode> elseNode,
-                                                          const LexerToken&         token)
+    ConditionalNode* createConditionalNode(ASTNode* condition, TreeNode* ifNode, TreeNode* elseNode,
+                                           const LexerToken& token)
     {
-        return std::make_unique<ConditionalNode>(std::move(condition), std::move(ifNode), std::move(elseNode), token);
+        return m_arena->create<ConditionalNode>(condition, ifNode, elseNode, token);
     }
-    static std::unique_ptr<TreeNode> createTreeNode(std::vector<std::unique_ptr<ASTNode>> children,
-                                                    const LexerToken&                     token)
+    //! `children` is copied into the arena, so the caller may reuse its storage
+    TreeNode* createTreeNode(std::span<ASTNode* const> children, const LexerToken& token)
     {
-        return std::make_unique<TreeNode>(std::move(children), token);
+        return m_arena->create<TreeNode>(m_arena->copy(children), token);
     }
+
+    //! Whether pure subtrees made from now on share the nodes of equal ones
+    void shareNodes(bool share) { m_shareNodes = share; }
+    //! Makes no later subtree share a node made so far, for after SubtreeTable::clear()
+    void forgetNodes() { m_nodes.clear(); }
+
+  private:
+    BinaryNode* create(ASTNode* left, ASTNode* right, const LexerToken& token, std::uint64_t hash)
+    {
+        auto node  = m_arena->create<BinaryNode>(left, right, token);
+        node->hash = hash;
+        return node;
+    }
+
+    Arena*                                         m_arena;
+    SubtreeTable*                                  m_subtrees;
+    bool                                           m_shareNodes;
+    size_t                                         m_resets; // Arena::resetCount() when m_nodes was filled
+    std::unordered_map<std::uint64_t, BinaryNode*> m_nodes;  // pure nodes made in the arena, by hash
 };
\ No newline at end of file
@@ -1,19 +1,126 @@
 #include "Parser.hpp"
-#include <memory>
+#include <algorithm>
+#include <array>
 #include <string>
 
-Parser::Parser(std::string_view data, CompilerOutput& output)
-    : m_lexer(std::make_unique<Lexer>(data))
-    , m_prevToken({"Program", {0, 0}, LexerTokenType::ProgramToken})
+namespace
+{
+// Binding power of the binary operators; a higher value binds tighter and every level is left-associative
+constexpr std::uint8_t comparisonPrecedence     = 1;
+constexpr std::uint8_t additivePrecedence       = 2;
+constexpr std::uint8_t multiplicativePrecedence = 3;
+
+constexpr auto precedenceTable = []
+{
+    std::array<std::uint8_t, static_cast<size_t>(LexerTokenType::Unknown) + 1> table{};
+    for (auto type : {LexerTokenType::EqualToken,
+                      LexerTokenType::NotEqualToken,
+                      LexerTokenType::LessToken,
+                      LexerTokenType::LessEqualToken,
+                      LexerTokenType::GreaterToken,
+                      LexerTokenType::GreaterEqualToken})
+        table[static_cast<size_t>(type)] = comparisonPrecedence;
+    for (auto type : {LexerTokenType::PlusToken, LexerTokenType::MinusToken})
+        table[static_cast<size_t>(type)] = additivePrecedence;
+    for (auto type : {LexerTokenType::MultiplyToken, LexerTokenType::DivideToken})
+        table[static_cast<size_t>(type)] = multiplicativePrecedence;
+    return table;
+}();
+
+// 0 for tokens that are not binary operators, which ends every expression loop
+constexpr std::uint8_t precedenceOf(LexerTokenType type)
+{
+    return precedenceTable[static_cast<size_t>(type)];
+}
+
+static_assert(precedenceOf(LexerTokenType::MultiplyToken) > precedenceOf(LexerTokenType::MinusToken));
+static_assert(precedenceOf(LexerTokenType::AssignToken) == 0);
+} // namespace
+
+class Parser::NestingGuard
+{
+  public:
+    explicit NestingGuard(Parser& parser) : m_parser(parser) { ++m_parser.m_nesting; }
+    ~NestingGuard() { --m_parser.m_nesting; }
+
+    NestingGuard(const NestingGuard&)            = delete;
+    NestingGuard& operator=(const NestingGuard&) = delete;
+
+    //! Whether the level this guard entered is deeper than the parser allows
+    bool tooDeep() const { return m_parser.m_nesting > m_parser.m_maxNesting; }
+
+  private:
+    Parser& m_parser;
+};
+
+Parser::Parser(std::string_view data,
+               CompilerOutput&  output,
+               Arena&           arena,
+               size_t           maxNesting,
+               Diagnostics*     diagnostics,
+               bool             shareSubtrees,
+               ThreadPool*      lexPool)
+    : m_tokens(Lexer::tokenize(data, lexPool))
+    , m_lines(data)
+    , m_prevToken({"Program", noSourceOffset, LexerTokenType::ProgramToken})
     , m_output(output)
+    , m_shareSubtrees(shareSubtrees)
+    , m_factory(arena, shareSubtrees ? &m_subtrees : nullptr)
+    , m_maxNesting(maxNesting)
+    , m_diagnostics(diagnostics)
+    , m_lexPool(lexPool)
+{
+}
+
+void Parser::reset(std::string_view data, std::uint32_t firstLine)
+{
+    // After an error in an earlier slice the "Lexer" section takes nothing more, except when the error
+    // came while looking past the end of the previous slice: the whole input shows that token from here
+    if (m_consumedBeforeError != SIZE_MAX)
+        m_consumedBeforeError = m_consumedBeforeError >= m_tokens.size() ? 1 : 0;
+    m_tokens = Lexer::tokenize(data, m_lexPool);
+    if (m_identifiers)
+        m_tokens.intern(*m_identifiers);
+    m_lines  = LineIndex(data, firstLine);
+    // The subtrees the hashes were given to are views of the previous slice
+    m_subtrees.clear();
+    m_factory.forgetNodes();
+    m_cursor   = 0;
+    m_consumed = 0;
+    m_scratch.clear();
+    m_nesting    = 0;
+    m_braceDepth = 0;
+}
+
+void Parser::useIdentifiers(IdentifierTable& identifiers)
+{
+    m_identifiers = &identifiers;
+    m_tokens.intern(identifiers);
+}
 
+void Parser::rewind(const Position& position)
 {
+    m_cursor     = position.cursor;
+    m_consumed   = position.consumed;
+    m_prevToken  = position.prevToken;
+    m_braceDepth = position.braceDepth;
 }
 
-void Parser::addTokenToOutput(const LexerToken& token)
+void Parser::addTokensToOutput(nlohmann::json* eof)
 {
-    m_output.getJson()["Lexer"].push_back(
-        {{"type", toString(token.type)}, {"value", token.value}, {"location", token.location.toString()}});
+    const size_t consumed = std::min(m_consumed, m_consumedBeforeError);
+    if (consumed == 0)
+        return;
+
+    auto& lexer = m_output.getJson()["Lexer"];
+    for (size_t i = 0; i < consumed; ++i)
+    {
+        const auto token = m_tokens.token(std::min(i, m_tokens.size() - 1));
+        auto&      into  = eof && token.type == LexerTokenType::Eof ? *eof : lexer;
+        into.push_back({{"type", toString(token.type)},
+                        {"value", token.value},
+                        {"location", m_lines.locate(token.offset).toString()}});
+    }
 }
 
 // Helper methods
@@ -29,11 +136,67 @@ void Parser::advancePastNewlines(LexerToken& token)
         advanceToken(token);
 }
 
+void Parser::synchronize(LexerToken& token)
+{
+    m_scratch.clear();
+    skipToBraceDepth(token, 0);
+}
+
+// Advances to the next newline or '}' with `depth` braces open before it, or to the end of the token stream
+void Parser::skipToBraceDepth(LexerToken& token, size_t depth)
+{
+    while (token.type != LexerTokenType::Eof && token.type != LexerTokenType::Unknown)
+    {
+        if (m_braceDepth == depth &&
+            (token.type == LexerTokenType::Newline || (token.type == LexerTokenType::BracesClose && depth > 0)))
+            return;
+        advanceToken(token);
+    }
+}
+
+// Records `error` and moves to the next statement of the block whose body has `depth` braces open.
+// Errors that cannot be recovered from here, or that no longer fit, go back to the caller unrecorded.
+Expected<void> Parser::recoverInBlock(const Error& error, LexerToken& token, size_t depth)
+{
+    if (!m_diagnostics || m_diagnostics->full() || error.getType() == ErrorType::LEXICAL)
+        return Unexpected(error);
+
+    markError();
+    skipToBraceDepth(token, depth);
+    if (token.type == LexerTokenType::Eof)
+        return Unexpected(error); // the block never closes; the caller recovers at the top level
+
+    Error located = error;
+    located.setLocation(locate(error.getOffset()));
+    m_diagnostics->report(located);
+    if (token.type == LexerTokenType::Unknown)
+        return Unexpected(*m_tokens.error()); // nothing can be parsed past a lexical error
+    return {};
+}
+
 void Parser::advanceToken(LexerToken& token)
 {
+    if (token.type == LexerTokenType::BracesOpen)
+        ++m_braceDepth;
+    else if (token.type == LexerTokenType::BracesClose && m_braceDepth > 0)
+        --m_braceDepth;
+
     m_prevToken = token;
-    token       = m_lexer->nextNWToken();
-    addTokenToOutput(token);
+    token       = m_tokens.token(m_cursor);
+    // The final Eof is sticky, as it was when pulling from the lexer; so is the entry of a lexical
+    // error, which the Lexer section leaves out
+    if (m_cursor + 1 < m_tokens.size())
+        ++m_cursor;
+    if (token.type != LexerTokenType::Unknown)
+        ++m_consumed;
+}
+
+Unexpected<Error> Parser::fail(std::string message, const LexerToken& token) const
+{
+    // Parsing stops at the first token the lexer could not read; that is the error to report
+    if (token.type == LexerTokenType::Unknown)
+        return Unexpected(*m_tokens.error());
+    return Unexpected(Error(std::move(message), token.offset, ErrorType::SYNTAX));
 }
 
 bool Parser::isValidFactorStart(LexerTokenType type)
@@ -43,171 +206,203 @@ bool Parser::isValidFactorStart(LexerTokenType type)
 }
 
 // Parsing methods
-std::unique_ptr<ASTNode> Parser::parseStatement(LexerToken& token)
+#if !defined(CURIOUSX_NO_EXCEPTIONS)
+ASTNode* Parser::parseStatement(LexerToken& token)
 {
+    auto statement = tryParseStatement(token);
+    if (!statement)
+        throw statement.error();
+    return *statement;
+}
+#endif
+
+Expected<ASTNode*> Parser::tryParseStatement(LexerToken& token)
+{
+    // A loop rather than a tail call: unoptimised builds would grow the stack with every blank line
+    while (token.type == LexerTokenType::CommentToken || token.type == LexerTokenType::Newline)
+        advanceToken(token);
+
     switch (token.type)
     {
-    case LexerTokenType::CommentToken:
-    case LexerTokenType::Newline:
-        advanceToken(token);
-        return parseStatement(token);
     case LexerTokenType::IfToken:
         return parseConditional(token);
     case LexerTokenType::PrintToken:
         return parsePrintStatement(token);
     default:
-        return parseExpression(token);
+        return parseExpression(token, additivePrecedence, ExpressionContext::Statement);
     }
 }
 
-std::unique_ptr<ASTNode> Parser::parseExpression(LexerToken& token)
+Expected<ASTNode*> Parser::parseExpression(LexerToken& token, std::uint8_t minPrecedence, ExpressionContext context)
 {
-    auto left = parseTerm(token);
-    while (token.type == LexerTokenType::PlusToken || token.type == LexerTokenType::MinusToken)
+    // Operands of * and / are plain factors; anywhere else an operand may start an assignment
+    auto left = parseOperand(token, minPrecedence <= multiplicativePrecedence, context);
+    if (!left)
+        return left;
+
+    // Left-associative chains are folded in this loop; recursion only descends one level per precedence
+    for (auto precedence = precedenceOf(token.type); precedence >= minPrecedence; precedence = precedenceOf(token.type))
     {
         auto op = token;
         advanceToken(token);
-        auto right = parseTerm(token);
-        left       = ASTNodeFactory::createBinaryNode(std::move(left), std::move(right), op);
+        auto right = parseExpression(token, static_cast<std::uint8_t>(precedence + 1), context);
+        if (!right)
+            return right;
+        left = m_factory.createBinaryNode(*left, *right, op);
     }
     return left;
 }
 
-std::unique_ptr<ASTNode> Parser::parseTerm(LexerToken& token)
+Expected<ASTNode*> Parser::parseOperand(LexerToken& token, bool allowAssignment, ExpressionContext context)
 {
-    auto left = parseFactor(token);
+    auto operand = parseFactor(token);
+    if (!operand)
+        return operand;
     advanceToken(token);
 
-    if (token.type == LexerTokenType::Eof)
-        return left;
-
-    if (token.type == LexerTokenType::AssignToken)
-        return parseAssignment(left, token);
-
-    while (token.type == LexerTokenType::MultiplyToken || token.type == LexerTokenType::DivideToken)
+    if (token.type == LexerTokenType::AssignToken && allowAssignment)
     {
-        auto op = token;
-        advanceToken(token);
-        auto right = parseFactor(token);
-        left       = ASTNodeFactory::createBinaryNode(std::move(left), std::move(right), op);
-        advanceToken(token);
+        if (context == ExpressionContext::Print)
+            return fail("Assignment is not allowed within print statement", token);
+        return parseAssignment(*operand, token);
     }
-    return left;
+    return operand;
 }
 
-std::unique_ptr<ASTNode> Parser::parseAssignment(std::unique_ptr<ASTNode>& left, LexerToken& token)
+Expected<ASTNode*> Parser::parseAssignment(ASTNode* left, LexerToken& token)
 {
     if (left->token.type != LexerTokenType::VarToken)
-        throw Error("Chained assignments are not allowed", left->token.location, ErrorType::SYNTAX);
+        return fail("Chained assignments are not allowed", left->token);
     auto type = token;
     advanceToken(token);
-    std::unique_ptr<ASTNode> right = parseExpression(token);
-    return ASTNodeFactory::createBinaryNode(std::move(left), std::move(right), type);
+    auto right = parseExpression(token, additivePrecedence, ExpressionContext::Statement);
+    if (!right)
+        return right;
+    return m_factory.createBinaryNode(left, *right, type);
 }
 
-std::unique_ptr<ASTNode> Parser::parseFactor(LexerToken& token)
+Expected<ASTNode*> Parser::parseFactor(LexerToken& token)
 {
     if (isValidFactorStart(token.type))
     {
-        return ASTNodeFactory::createBinaryNode(nullptr, nullptr, token);
+        return m_factory.createBinaryNode(nullptr, nullptr, token);
     }
     else if (token.type == LexerTokenType::ParenOpen)
     {
+        NestingGuard nesting(*this);
+        if (nesting.tooDeep())
+            return nestingError(token);
         advanceToken(token);
-        auto expr = parseExpression(token);
-        if (token.type != LexerTokenType::ParenClose)
-        {
-            throw Error("Expected closing parenthesis", token.location, ErrorType::SYNTAX);
-        }
+        auto expr = parseExpression(token, additivePrecedence, ExpressionContext::Statement);
+        if (expr && token.type != LexerTokenType::ParenClose)
+            return fail("Expected closing parenthesis", token);
         return expr;
     }
 
-    handleUnexpectedToken(token);
-    return nullptr;
+    return unexpectedToken(token);
 }
 
-void Parser::handleUnexpectedToken(const LexerToken& token)
+Unexpected<Error> Parser::unexpectedToken(const LexerToken& token) const
 {
     switch (token.type)
     {
     case LexerTokenType::ElseToken:
-        throw Error("Unexpected 'else' keyword. 'else' must be preceded by 'if'", token.location, ErrorType::SYNTAX);
+        return fail("Unexpected 'else' keyword. 'else' must be preceded by 'if'", token);
     case LexerTokenType::ParenClose:
-        throw Error("Unexpected closing parenthesis ')'", token.location, ErrorType::SYNTAX);
+        return fail("Unexpected closing parenthesis ')'", token);
     case LexerTokenType::Eof:
-        throw Error("Unexpected end of file. Expression is incomplete", token.location, ErrorType::SYNTAX);
+        return fail("Unexpected end of file. Expression is incomplete", token);
     case LexerTokenType::AssignToken:
-        throw Error("Assignment is not allowed within print statement", token.location, ErrorType::SYNTAX);
+        return fail("Assignment is not allowed within print statement", token);
     default:
-        throw Error("Unexpected token '" + std::string(token.value) + "' in factor", token.location, ErrorType::SYNTAX);
+        return fail("Unexpected token '" + std::string(token.value) + "' in factor", token);
     }
 }
 
-std::unique_ptr<ASTNode> Parser::parseConditional(LexerToken& token)
+Unexpected<Error> Parser::nestingError(const LexerToken& token) const
+{
+    return fail("Nesting is too deep: at most " + std::to_string(m_maxNesting) +
+                    " levels of parentheses and blocks are allowed",
+                token);
+}
+
+Expected<ASTNode*> Parser::parseConditional(LexerToken& token)
 {
     if (m_prevToken.type != LexerTokenType::Newline && m_prevToken.type != LexerTokenType::ProgramToken)
-    {
-        throw Error(
-            "'if' statement cannot start a program and must start on a new line", token.location, ErrorType::SYNTAX);
-    }
+        return fail("'if' statement cannot start a program and must start on a new line", token);
 
     // condition
     auto op = token;
     advanceToken(token);
     auto cond = parseComparisonExpression(token);
+    if (!cond)
+        return cond;
 
     // then block
     advanceToken(token);
-    auto then = parseBlock(token, {"then", {0, 0}, LexerTokenType::ElseToken});
+    auto then = parseBlock(token, {"then", noSourceOffset, LexerTokenType::ElseToken});
+    if (!then)
+        return Unexpected(then.error());
 
     // else block
-    std::unique_ptr<TreeNode> elseBlock = nullptr;
+    TreeNode* elseBlock = nullptr;
     while (token.type == LexerTokenType::Newline)
         advanceToken(token);
     if (token.type == LexerTokenType::ElseToken)
     {
         advanceToken(token);
-        elseBlock = parseBlock(token, {"Else", {0, 0}, LexerTokenType::ElseToken});
+        auto block = parseBlock(token, {"Else", noSourceOffset, LexerTokenType::ElseToken});
+        if (!block)
+            return Unexpected(block.error());
+        elseBlock = *block;
     }
 
-    return ASTNodeFactory::createConditionalNode(std::move(cond), std::move(then), std::move(elseBlock), op);
+    return m_factory.createConditionalNode(*cond, *then, elseBlock, op);
 }
 
-std::unique_ptr<ASTNode> Parser::parseComparisonExpression(LexerToken& token)
+Expected<ASTNode*> Parser::parseComparisonExpression(LexerToken& token)
 {
     if (token.type != LexerTokenType::ParenOpen)
-        throw Error("Expected opening parenthesis", token.location, ErrorType::SYNTAX);
+        return fail("Expected opening parenthesis", token);
 
     advanceToken(token);
-    auto left = parseExpression(token);
+    auto left = parseExpression(token, additivePrecedence, ExpressionContext::Statement);
+    if (!left)
+        return left;
 
-    if (token.type == LexerTokenType::GreaterToken || token.type == LexerTokenType::LessToken ||
-        token.type == LexerTokenType::GreaterEqualToken || token.type == LexerTokenType::LessEqualToken ||
-        token.type == LexerTokenType::EqualToken || token.type == LexerTokenType::NotEqualToken)
+    // A condition holds at most one comparison
+    if (precedenceOf(token.type) == comparisonPrecedence)
     {
         auto op = token;
         advanceToken(token);
-        auto right = parseExpression(token);
-        left       = ASTNodeFactory::createBinaryNode(std::move(left), std::move(right), op);
+        auto right = parseExpression(token, additivePrecedence, ExpressionContext::Statement);
+        if (!right)
+            return right;
+        left = m_factory.createBinaryNode(*left, *right, op);
     }
 
     if (token.type != LexerTokenType::ParenClose)
-        throw Error("Expected closing Braces", token.location, ErrorType::SYNTAX);
+        return fail("Expected closing Braces", token);
     return left;
 }
 
-std::unique_ptr<TreeNode> Parser::parseBlock(LexerToken& token, LexerToken what)
+Expected<TreeNode*> Parser::parseBlock(LexerToken& token, LexerToken what)
 {
     while (token.type == LexerTokenType::Newline)
         advanceToken(token);
 
-    std::vector<std::unique_ptr<ASTNode>> statements;
-    LexerToken                            blockToken = what;
+    // Statements collect on the shared scratch stack; nested blocks push and pop above them
+    const size_t base       = m_scratch.size();
+    LexerToken   blockToken = what;
 
     if (token.type != LexerTokenType::BracesOpen)
-        throw Error("Expected opening braces for block", token.location, ErrorType::SYNTAX);
+        return fail("Expected opening braces for block", token);
 
+    NestingGuard nesting(*this);
+    if (nesting.tooDeep())
+        return nestingError(token);
     advanceToken(token); // Consume '{'
+    const size_t depth = m_braceDepth;
 
     while (token.type != LexerTokenType::BracesClose)
     {
@@ -217,140 +412,122 @@ std::unique_ptr<TreeNode> Parser::parseBlock(LexerToken& token, LexerToken what)
         if (token.type == LexerTokenType::BracesClose)
             break;
 
-        auto statement = parseStatement(token);
-        statements.push_back(std::move(statement));
+        const size_t statements = m_scratch.size();
+        auto         statement  = tryParseStatement(token);
+        if (statement)
+        {
+            m_scratch.push_back(*statement);
+        }
+        else
+        {
+            // A failed nested block leaves its statements behind
+            m_scratch.resize(statements);
+            if (auto recovered = recoverInBlock(statement.error(), token, depth); !recovered)
+            {
+                m_scratch.resize(base);
+                return Unexpected(recovered.error());
+            }
+        }
 
         while (token.type == LexerTokenType::Newline)
             advanceToken(token);
     }
 
     if (token.type != LexerTokenType::BracesClose)
-        throw Error("Expected closing braces at end of block", token.location, ErrorType::SYNTAX);
+    {
+        m_scratch.resize(base);
+        return fail("Expected closing braces at end of block", token);
+    }
 
     advanceToken(token); // Consume '}'
-    return ASTNodeFactory::createTreeNode(std::move(statements), blockToken);
+    auto block = m_factory.createTreeNode(std::span(m_scratch).subspan(base), blockToken);
+    m_scratch.resize(base);
+    return block;
 }
 
-std::unique_ptr<ASTNode> Parser::parsePrintStatement(LexerToken& token)
+Expected<ASTNode*> Parser::parsePrintStatement(LexerToken& token)
 {
     auto printToken = token;
     advanceToken(token); // Consume 'print' token
 
     if (token.type != LexerTokenType::ParenOpen)
-        throw Error("Expected opening parenthesis after 'print'", token.location, ErrorType::SYNTAX);
+        return fail("Expected opening parenthesis after 'print'", token);
 
     advanceToken(token); // Consume '('
 
-    auto expression = parsePrintExpression(token);
+    auto expression = parseExpression(token, comparisonPrecedence, ExpressionContext::Print);
+    if (!expression)
+        return expression;
 
     if (token.type != LexerTokenType::ParenClose)
-        throw Error("Expected closing parenthesis after print expression", token.location, ErrorType::SYNTAX);
+        return fail("Expected closing parenthesis after print expression", token);
 
     advanceToken(token); // Consume ')'
 
-    std::vector<std::unique_ptr<ASTNode>> children;
-    children.emplace_back(std::move(expression));
-
-    return ASTNodeFactory::createTreeNode(std::move(children), printToken);
-}
-
-std::unique_ptr<ASTNode> Parser::parsePrintExpression(LexerToken& token)
-{
-    auto left = parsePrintTerm(token);
-
-    while (token.type == LexerTokenType::PlusToken || token.type == LexerTokenType::MinusToken ||
-           token.type == LexerTokenType::GreaterToken || token.type == LexerTokenType::LessToken ||
-           token.type == LexerTokenType::GreaterEqualToken || token.type == LexerTokenType::LessEqualToken ||
-           token.type == LexerTokenType::EqualToken || token.type == LexerTokenType::NotEqualToken)
-    {
-        auto op = token;
-        advanceToken(token);
-        auto right = parseTerm(token);
-        left       = ASTNodeFactory::createBinaryNode(std::move(left), std::move(right), op);
-    }
-
-    return left;
-}
-
-std::unique_ptr<ASTNode> Parser::parsePrintTerm(LexerToken& token)
-{
-    auto left = parseFactor(token);
-    advanceToken(token);
-
-    if (token.type == LexerTokenType::AssignToken)
-        throw Error("Assignment is not allowed within print statement", token.location, ErrorType::SYNTAX);
-
-    while (token.type == LexerTokenType::MultiplyToken || token.type == LexerTokenType::DivideToken)
-    {
-        auto op = token;
-        advanceToken(token);
-        auto right = parseFactor(token);
-        left       = ASTNodeFactory::createBinaryNode(std::move(left), std::move(right), op);
-    }
-
-    return left;
+    ASTNode* const children[] = {*expression};
+    return m_factory.createTreeNode(children, printToken);
 }
 
 // Json output methods
 
-void Parser::addASTToOutput(const std::unique_ptr<TreeNode>& root)
+void Parser::addASTToOutput(const FlatAST& ast, FlatAST::NodeId root)
 {
-    m_output.getJson()["AST"] = nodeToJson(root.get());
+    m_output.getJson()["AST"] = astToJson(ast, root);
 }
 
-nlohmann::json Parser::nodeToJson(const ASTNode* node)
+nlohmann::json Parser::astToJson(const FlatAST& ast, FlatAST::NodeId root)
 {
-    if (!node)
-        return nullptr;
-
-    nlohmann::json j = {{"type", getNodeTypeName(node->getType())},
-                        {"token",
-                         {{"type", toString(node->token.type)},
-                          {"value", node->token.value},
-                          {"location", node->token.location.toString()}}}};
-
-    switch (node->getType())
-    {
-    case NodeType::BinaryOperation:
-        jsonifyBinaryNode(j, static_cast<const BinaryNode*>(node));
-        break;
-    case NodeType::ConditionalOperation:
-        jsonifyConditionalNode(j, static_cast<const ConditionalNode*>(node));
-        break;
-    case NodeType::BlockOperation:
-        jsonifyBlockNode(j, static_cast<const TreeNode*>(node));
-        break;
-    default:
-        // No additional processing needed for unknown types
-        break;
-    }
-
-    return j;
-}
-
-void Parser::jsonifyBinaryNode(nlohmann::json& j, const BinaryNode* node)
-{
-    j["left"]  = nodeToJson(node->left.get());
-    j["right"] = nodeToJson(node->right.get());
-}
-
-void Parser::jsonifyConditionalNode(nlohmann::json& j, const ConditionalNode* node)
-{
-    j["condition"] = nodeToJson(node->condition.get());
-    j["ifNode"]    = nodeToJson(node->ifNode.get());
-    if (node->elseNode)
-    {
-        j["elseNode"] = nodeToJson(node->elseNode.get());
-    }
+    // Occurrences come children first, so the JSON of a node's children is on top of `built` when it is
+    // reached; a shared subtree is built again for each of its occurrences
+    std::vector<nlohmann::json> built;
+    ast.forEachOccurrence(
+        root,
+        [&](FlatAST::NodeId id, const LexerToken& token)
+        {
+            const auto     kids    = ast.children(id);
+            const auto     present = static_cast<size_t>(std::count_if(
+                kids.begin(), kids.end(), [](FlatAST::NodeId child) { return child != FlatAST::none; }));
+            auto           next    = built.end() - static_cast<std::ptrdiff_t>(present);
+            auto           take    = [&](FlatAST::NodeId child) -> nlohmann::json
+            {
+                if (child == FlatAST::none)
+                    return nullptr;
+                return std::move(*next++);
+            };
+            nlohmann::json j = {{"type", getNodeTypeName(ast.kind(id))},
+                                {"token",
+                                 {{"type", toString(token.type)},
+                                  {"value", token.value},
+                                  {"location", m_lines.locate(token.offset).toString()}}}};
+
+            switch (ast.kind(id))
+            {
+            case NodeType::BinaryOperation:
+                j["left"]  = take(kids[0]);
+                j["right"] = take(kids[1]);
+                break;
+            case NodeType::ConditionalOperation:
+                j["condition"] = take(kids[0]);
+                j["ifNode"]    = take(kids[1]);
+                if (kids[2] != FlatAST::none)
+                    j["elseNode"] = take(kids[2]);
+                break;
+            case NodeType::BlockOperation:
+                j["children"] = nlohmann::json::array();
+                for (auto child : kids)
+                    j["children"].push_back(take(child));
+                break;
+            }
+            built.resize(built.size() - present);
+            built.push_back(std::move(j));
+        });
+
+    return std::move(built.back());
 }
 
-void Parser::jsonifyBlockNode(nlohmann::json& j, const TreeNode* node)
+std::string Parser::binaryAST(const FlatAST& ast, FlatAST::NodeId root) const
 {
-    j["children"] = nlohmann::json::array();
-    for (const auto& child : node->children)
-    {
-        j["children"].push_back(nodeToJson(child.get()));
-    }
+    return BinaryASTWriter(m_lines).write(ast, root);
 }
 
 std::string Parser::getNodeTypeName(NodeType type)
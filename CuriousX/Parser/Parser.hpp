@@ -1,49 +1,145 @@
 #pragma once
 
+#include "BinaryAST.hpp"
+#include "CompilerOptions.hpp"
 #include "CompilerOutput.hpp"
+#include "Diagnostics.hpp"
+#include "Expected.hpp"
+#include "LineIndex.hpp"
+#include "FlatAST.hpp"
 #include "Node.hpp"
-#include <memory>
+#include <algorithm>
+#include <cstdint>
 #include <string_view>
 #include <vector>
 
 class Parser
 {
   public:
-    explicit Parser(std::string_view data, CompilerOutput& output);
+    //! Nodes are allocated in `arena`; the returned trees stay valid until it is reset. Parentheses
+    //! and blocks nested more than `maxNesting` deep are rejected. Without `diagnostics` the first
+    //! error ends the statement; with it, errors inside blocks are recorded there and the block
+    //! resumes at its next statement. With `shareSubtrees`, pure nodes carry a structural hash (see
+    //! SubtreeTable) and equal ones are one node until shareNodes() turns that off. Large inputs are
+    //! lexed on `lexPool` if one is given (Lexer::tokenize).
+    Parser(std::string_view data,
+           CompilerOutput&  output,
+           Arena&           arena,
+           size_t           maxNesting    = defaultMaxNestingDepth,
+           Diagnostics*     diagnostics   = nullptr,
+           bool             shareSubtrees = false,
+           ThreadPool*      lexPool       = nullptr);
 
-    std::unique_ptr<ASTNode> parseStatement(LexerToken& token);
-    void                     advanceToken(LexerToken& token);
-    bool                     expectNewlineOrEOF(const LexerToken& token) const;
-    void                     advancePastNewlines(LexerToken& token);
-    void                     addASTToOutput(const std::unique_ptr<TreeNode>& root);
+    //! Where the parser stands between two top-level statements
+    struct Position
+    {
+        size_t     cursor;
+        size_t     consumed;
+        LexerToken prevToken;
+        size_t     braceDepth;
+    };
+
+    //! Restarts on a new slice of the input whose first line is `firstLine`
+    void     reset(std::string_view data, std::uint32_t firstLine);
+    Position position() const { return {m_cursor, m_consumed, m_prevToken, m_braceDepth}; }
+    //! Returns to a position taken earlier on the same input; the caller restores its token too
+    void     rewind(const Position& position);
+    //! Interns the variables of the input, and of inputs given to reset() later, into `identifiers`,
+    //! so their tokens carry a SymbolId
+    void     useIdentifiers(IdentifierTable& identifiers);
+    //! Allocates the nodes of the statements parsed from now on in `arena`
+    void     useArena(Arena& arena)
+    {
+        m_factory = ASTNodeFactory(arena, m_shareSubtrees ? &m_subtrees : nullptr, m_shareNodes);
+    }
+    //! With shareSubtrees, whether equal pure subtrees are one node, which then has the token of the
+    //! first occurrence. Off, every occurrence is a node with its own token, and only the hashes are
+    //! shared.
+    void     shareNodes(bool share)
+    {
+        m_shareNodes = share;
+        m_factory.shareNodes(share);
+    }
+    bool     sharesNodes() const { return m_shareSubtrees && m_shareNodes; }
+
+    //! Parses one statement, or returns the first error that prevents it
+    Expected<ASTNode*> tryParseStatement(LexerToken& token);
+#if !defined(CURIOUSX_NO_EXCEPTIONS)
+    //! Throwing form of tryParseStatement()
+    ASTNode*           parseStatement(LexerToken& token);
+#endif
+    //! Moves to the next token. At a lexical error the token becomes an Unknown one and stays there;
+    //! parsing it reports the lexer's error.
+    void               advanceToken(LexerToken& token);
+    bool               expectNewlineOrEOF(const LexerToken& token) const;
+    void               advancePastNewlines(LexerToken& token);
+    //! Skips the rest of a top-level statement that failed to parse: up to the next newline outside
+    //! the blocks it opened, or to the end of input
+    void               synchronize(LexerToken& token);
+    void               addASTToOutput(const FlatAST& ast, FlatAST::NodeId root);
+    //! The JSON that addASTToOutput() writes for the tree under `root`
+    nlohmann::json     astToJson(const FlatAST& ast, FlatAST::NodeId root);
+    //! Encodes the same tree as addASTToOutput() in the binary AST format (see BinaryAST.hpp)
+    std::string        binaryAST(const FlatAST& ast, FlatAST::NodeId root) const;
+    //! Writes the "Lexer" section for every token consumed so far, in the order they were consumed, or
+    //! up to the first error once one was marked. With `eof`, the final Eof goes there instead, for a
+    //! slice of the input that later slices may follow.
+    void               addTokensToOutput(nlohmann::json* eof = nullptr);
+    //! Marks the tokens consumed so far as those leading up to the first error. Recovery may go on to
+    //! skip the rest of the input, which the "Lexer" section leaves out.
+    void               markError() { m_consumedBeforeError = std::min(m_consumedBeforeError, m_consumed); }
+    const TokenBuffer& tokens() const { return m_tokens; }
+    SourceLocation     locate(std::uint32_t offset) const { return m_lines.locate(offset); }
 
   private:
-    // Parsing methods
-    std::unique_ptr<ASTNode>  parseExpression(LexerToken& token);
-    std::unique_ptr<ASTNode>  parseTerm(LexerToken& token);
-    std::unique_ptr<ASTNode>  parseFactor(LexerToken& token);
-    std::unique_ptr<ASTNode>  parseConditional(LexerToken& token);
-    std::unique_ptr<ASTNode>  parseAssignment(std::unique_ptr<ASTNode>& left, LexerToken& token);
-    std::unique_ptr<ASTNode>  parseComparisonExpression(LexerToken& token);
-    std::unique_ptr<TreeNode> parseBlock(LexerToken& token, LexerToken what);
-    std::unique_ptr<ASTNode>  parsePrintStatement(LexerToken& token);
-    std::unique_ptr<ASTNode>  parsePrintExpression(LexerToken& token);
-    std::unique_ptr<ASTNode>  parsePrintTerm(LexerToken& token);
+    //! Print arguments accept comparisons but no assignments
+    enum class ExpressionContext
+    {
+        Statement,
+        Print
+    };
+
+    //! Counts one level of parentheses or block nesting while in scope
+    class NestingGuard;
+
+    // Parsing methods; errors are returned, since invalid input is common and unwinding is costly
+    Expected<ASTNode*>  parseExpression(LexerToken& token, std::uint8_t minPrecedence, ExpressionContext context);
+    Expected<ASTNode*>  parseOperand(LexerToken& token, bool allowAssignment, ExpressionContext context);
+    Expected<ASTNode*>  parseFactor(LexerToken& token);
+    Expected<ASTNode*>  parseConditional(LexerToken& token);
+    Expected<ASTNode*>  parseAssignment(ASTNode* left, LexerToken& token);
+    Expected<ASTNode*>  parseComparisonExpression(LexerToken& token);
+    Expected<TreeNode*> parseBlock(LexerToken& token, LexerToken what);
+    Expected<ASTNode*>  parsePrintStatement(LexerToken& token);
 
     // Helper methods
-    bool isValidFactorStart(LexerTokenType type);
-    void handleUnexpectedToken(const LexerToken& token);
+    bool              isValidFactorStart(LexerTokenType type);
+    void              skipToBraceDepth(LexerToken& token, size_t depth);
+    Expected<void>    recoverInBlock(const Error& error, LexerToken& token, size_t depth);
+    Unexpected<Error> fail(std::string message, const LexerToken& token) const;
+    Unexpected<Error> unexpectedToken(const LexerToken& token) const;
+    Unexpected<Error> nestingError(const LexerToken& token) const;
 
     // Json functions
-    nlohmann::json nodeToJson(const ASTNode* node);
-    void           jsonifyBlockNode(nlohmann::json& j, const TreeNode* node);
-    void           jsonifyConditionalNode(nlohmann::json& j, const ConditionalNode* node);
-    void           jsonifyBinaryNode(nlohmann::json& j, const BinaryNode* node);
-    std::string    getNodeTypeName(NodeType type);
+    std::string getNodeTypeName(NodeType type);
 
-    void addTokenToOutput(const LexerToken& token);
     // Member variables
-    std::unique_ptr<Lexer> m_lexer;
-    LexerToken             m_prevToken;
-    CompilerOutput&        m_output;
+    TokenBuffer           m_tokens;
+    LineIndex             m_lines;
+    size_t                m_cursor   = 0;
+    size_t                m_consumed = 0; // tokens handed out, counting repeats of the final Eof
+    size_t                m_consumedBeforeError = SIZE_MAX; // m_consumed when the first error was marked
+    LexerToken            m_prevToken;
+    CompilerOutput&       m_output;
+    SubtreeTable          m_subtrees;
+    bool                  m_shareSubtrees;
+    bool                  m_shareNodes = true;
+    ASTNodeFactory        m_factory;
+    std::vector<ASTNode*> m_scratch; // children of the blocks being parsed
+    size_t                m_maxNesting;
+    size_t                m_nesting    = 0;
+    size_t                m_braceDepth = 0; // unclosed '{' before the current token
+    Diagnostics*          m_diagnostics;
+    IdentifierTable*      m_identifiers = nullptr;
+    ThreadPool*           m_lexPool;
 };
\ No newline at end of file
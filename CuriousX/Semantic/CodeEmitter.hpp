@@ -0,0 +1,25 @@
+#pragma once
+
+#include "Node.hpp"
+
+//! Receives the code of a statement while Semantic checks it, for fused analysis and generation
+//! (CompilerOptions::fuseCodegen). Semantic calls it in the order a code generator walks the tree, so
+//! the code comes out as if the checked statement had been generated afterwards. A statement that
+//! fails the check leaves whatever was emitted for it behind; the caller discards that.
+class CodeEmitter
+{
+  public:
+    virtual ~CodeEmitter() = default;
+
+    //! Code of one expression node, after that of its operands; the node is annotated already
+    virtual void emit(const BinaryNode& node) = 0;
+    //! Stores the value just emitted in `variable`
+    virtual void emitAssignment(const LexerToken& variable) = 0;
+    //! Starts the branches of a conditional, after its condition
+    virtual void emitIf() = 0;
+    //! Ends the if branch of a conditional that has an else branch
+    virtual void emitElse() = 0;
+    virtual void emitEnd() = 0;
+    //! Prints the arguments emitted since the print statement began
+    virtual void emitPrint() = 0;
+};
@@ -1,67 +1,211 @@
 #include "Semantic.hpp"
 #include <cmath>
+#include <cstdlib>
 #include <limits>
 #include <string>
 
+#if !defined(CURIOUSX_NO_EXCEPTIONS)
 void Semantic::analyzeTree(const ASTNode& node)
+{
+    if (auto analyzed = analyze(node); !analyzed)
+        throw analyzed.error();
+}
+#endif
+
+Expected<void> Semantic::analyze(const ASTNode& node, CodeEmitter& emitter)
+{
+    m_emitter     = &emitter;
+    auto analyzed = analyze(node);
+    m_emitter     = nullptr;
+    return analyzed;
+}
+
+Expected<void> Semantic::analyze(const ASTNode& node)
 {
     switch (node.getType())
     {
     case NodeType::BinaryOperation:
-        analyzeBinaryOperation(static_cast<const BinaryNode&>(node));
-        break;
+        return analyzeBinaryOperation(static_cast<const BinaryNode&>(node));
     case NodeType::ConditionalOperation:
-        analyzeConditionalOperation(static_cast<const ConditionalNode&>(node));
-        break;
+        return analyzeConditionalOperation(static_cast<const ConditionalNode&>(node));
     case NodeType::BlockOperation:
-        analyzeBlockOperation(static_cast<const TreeNode&>(node));
-        break;
+        return analyzeBlockOperation(static_cast<const TreeNode&>(node));
     default:
-        throw Error("Unexpected node type", node.token.location, ErrorType::SEMANTIC);
-        break;
+        return Unexpected(Error("Unexpected node type", node.token.offset, ErrorType::SEMANTIC));
     }
 }
 
-void Semantic::analyzeBinaryOperation(const BinaryNode& node)
+Expected<void> Semantic::analyzeBinaryOperation(const BinaryNode& node)
 {
     if (node.token.type == LexerTokenType::AssignToken)
     {
-        analyzeAssignment(node);
+        return analyzeAssignment(node);
     }
     else if (node.token.type == LexerTokenType::VarToken)
     {
-        inferType(node);
+        if (auto type = inferType(node); !type)
+            return Unexpected(type.error());
+        return {};
     }
     else
     {
-        analyzeExpression(node);
+        return analyzeExpression(node);
     }
 }
 
-void Semantic::analyzeAssignment(const BinaryNode& node)
+Expected<void> Semantic::analyzeAssignment(const BinaryNode& node)
 {
     if (node.left->token.type != LexerTokenType::VarToken)
     {
-        throw Error("Invalid assignment: left side must be a variable", node.left->token.location);
+        return Unexpected(Error("Invalid assignment: left side must be a variable", node.left->token.offset));
     }
 
-    const std::string& varName   = getVariableName(*node.left);
-    InferredType       rightType = inferType(*node.right);
+    const SymbolId variable  = getVariableId(*node.left);
+    auto           rightType = inferType(*node.right);
+    if (!rightType)
+        return Unexpected(rightType.error());
 
-    auto& symbolTable = ScopedSymbolTable::getInstance();
+    auto& symbolTable = m_symbols;
 
-    if (symbolTable.contains(varName))
-    {
-        auto existingType = symbolTable.lookup(varName);
-        ensureTypeMatch(existingType.value(), rightType, node.left->token);
-    }
+    Expected<void> declared;
+    if (auto existingType = symbolTable.lookup(variable))
+        declared = ensureTypeMatch(*existingType, *rightType, node.left->token);
     else
+        declared = symbolTable.tryInsert(variable, *rightType, node.left->token);
+    if (declared && m_emitter)
+        m_emitter->emitAssignment(node.left->token);
+    return declared;
+}
+
+Expected<InferredType> Semantic::inferType(const ASTNode& root)
+{
+    // Operands are checked before their subtrees are entered and typed once they are left; the
+    // types of finished subtrees wait on m_types until their operator is reached. Each node is
+    // annotated with its type as it is left, so no later pass infers it again.
+    const size_t         base = m_types.size();
+    std::optional<Error> failure;
+    const ASTNode*       reused = nullptr; // shared subtree whose type was inferred before
+    auto                 stop = [this, &failure](Error error)
     {
-        symbolTable.insert(varName, rightType, node.left->token);
+        failure = std::move(error);
+        m_walker.stop();
+    };
+
+    m_walker.walk(
+        root,
+        [&](const ASTNode& node)
+        {
+            if (isSimpleLiteralOrVariable(node))
+                return false;
+            if (auto known = sharedType(node))
+            {
+                annotateShared(static_cast<const BinaryNode&>(node), *known);
+                if (m_emitter)
+                    emitTree(node);
+                m_types.push_back(*known);
+                reused = &node;
+                return false;
+            }
+            if (!isValidBinaryType(node.token) && !isValidConditionType(node.token))
+            {
+                stop(Error("Unable to infer type", node.token.offset, ErrorType::SEMANTIC));
+                return false;
+            }
+
+            const auto& binary = static_cast<const BinaryNode&>(node);
+            if (!binary.left || !binary.right)
+            {
+                stop(Error("Unbalanced expression, missing operand", node.token.offset, ErrorType::SEMANTIC));
+                return false;
+            }
+            if (node.token.type == LexerTokenType::DivideToken)
+            {
+                if (auto checked = checkDivisionByZero(*binary.right); !checked)
+                {
+                    stop(checked.error());
+                    return false;
+                }
+            }
+            return true;
+        },
+        [&](const ASTNode& node)
+        {
+            if (&node == reused)
+            {
+                reused = nullptr;
+                return;
+            }
+            if (isSimpleLiteralOrVariable(node))
+            {
+                auto type = inferTypeFromLiteral(node);
+                if (!type)
+                    return stop(type.error());
+                annotate(node, *type);
+                if (m_emitter)
+                    m_emitter->emit(static_cast<const BinaryNode&>(node));
+                m_types.push_back(*type);
+                return;
+            }
+            const auto&        binary = static_cast<const BinaryNode&>(node);
+            const InferredType right  = m_types.back();
+            m_types.pop_back();
+            auto type = inferTypeFromOperation(binary, m_types.back(), right);
+            if (!type)
+                return stop(type.error());
+            annotate(node, *type);
+            if (m_emitter)
+                m_emitter->emit(binary);
+            m_types.back() = *type;
+            if (binary.hash)
+                m_sharedTypes.emplace(binary.hash, *type);
+        });
+
+    if (failure)
+    {
+        m_types.resize(base);
+        return Unexpected(std::move(*failure));
     }
+    const InferredType type = m_types.back();
+    m_types.resize(base);
+    return type;
+}
+
+void Semantic::annotate(const ASTNode& node, InferredType type)
+{
+    const auto& binary = static_cast<const BinaryNode&>(node);
+    binary.type        = type;
+    binary.readsVariable =
+        node.token.type == LexerTokenType::VarToken || readsVariable(binary.left) || readsVariable(binary.right);
 }
 
-InferredType Semantic::inferType(const ASTNode& node)
+bool Semantic::readsVariable(const ASTNode* node)
+{
+    return node && node->getType() == NodeType::BinaryOperation && static_cast<const BinaryNode*>(node)->readsVariable;
+}
+
+void Semantic::emitTree(const ASTNode& root)
+{
+    m_walker.postOrder(root, [this](const ASTNode& node) { m_emitter->emit(static_cast<const BinaryNode&>(node)); });
+}
+
+void Semantic::annotateShared(const BinaryNode& root, InferredType type)
+{
+    // Both operands of a well-typed operation have its type, so the whole subtree has it
+    m_walker.postOrder(root, [this, type](const ASTNode& node) { annotate(node, type); });
+}
+
+std::optional<InferredType> Semantic::sharedType(const ASTNode& node) const
+{
+    if (node.getType() != NodeType::BinaryOperation)
+        return std::nullopt;
+    const auto hash = static_cast<const BinaryNode&>(node).hash;
+    auto       it   = hash ? m_sharedTypes.find(hash) : m_sharedTypes.end();
+    if (it == m_sharedTypes.end())
+        return std::nullopt;
+    return it->second;
+}
+
+Expected<InferredType> Semantic::inferTypeFromLiteral(const ASTNode& node)
 {
     switch (node.token.type)
     {
@@ -73,68 +217,74 @@ InferredType Semantic::inferType(const ASTNode& node)
         return InferredType::STRING;
     case LexerTokenType::BoolToken:
         return InferredType::BOOL;
-    case LexerTokenType::VarToken:
-        return inferTypeFromVariable(node);
-    case LexerTokenType::PlusToken:
-    case LexerTokenType::MinusToken:
-    case LexerTokenType::DivideToken:
-    case LexerTokenType::MultiplyToken:
-    case LexerTokenType::EqualToken:
-    case LexerTokenType::NotEqualToken:
-    case LexerTokenType::GreaterEqualToken:
-    case LexerTokenType::GreaterToken:
-    case LexerTokenType::LessEqualToken:
-    case LexerTokenType::LessToken:
-        return inferTypeFromOperation(static_cast<const BinaryNode&>(node));
     default:
-        throw Error("Unable to infer type", node.token.location, ErrorType::SEMANTIC);
+        return inferTypeFromVariable(node);
     }
 }
 
-void Semantic::analyzeExpression(const BinaryNode& node)
+Expected<void> Semantic::analyzeExpression(const BinaryNode& node)
 {
-    if (node.left && node.right)
+    const bool binary = node.left && node.right;
+    if (binary)
     {
-        ensureTypeMatch(inferType(*node.left), inferType(*node.right), node.token);
+        if (auto matched = inferOperandTypes(node); !matched)
+            return matched;
     }
 
-    if (!containsNonLiteral(node))
+    // Operands annotated above tell whether a variable is read; a lone operand is walked instead
+    if (!(node.type ? node.readsVariable : containsNonLiteral(node)))
     {
-        throw Error("Literal expressions without effect are not allowed", node.token.location, ErrorType::SEMANTIC);
+        return Unexpected(
+            Error("Literal expressions without effect are not allowed", node.token.offset, ErrorType::SEMANTIC));
     }
+    if (m_emitter)
+        binary ? m_emitter->emit(node) : emitTree(node);
+    return {};
 }
 
-bool Semantic::containsNonLiteral(const ASTNode& node) const
+// Infers both operands of `node`, left first, checks that their types agree and annotates `node`
+Expected<void> Semantic::inferOperandTypes(const BinaryNode& node)
 {
-    if (node.token.type == LexerTokenType::VarToken) {
-        return true;
-    }
+    auto leftType = inferType(*node.left);
+    if (!leftType)
+        return Unexpected(leftType.error());
+    auto rightType = inferType(*node.right);
+    if (!rightType)
+        return Unexpected(rightType.error());
+    if (auto matched = ensureTypeMatch(*leftType, *rightType, node.token); !matched)
+        return matched;
+    annotate(node, *leftType);
+    return {};
+}
 
-    if (node.getType() == NodeType::BinaryOperation) {
-        const auto* binaryNode = dynamic_cast<const BinaryNode*>(&node);
-        
-        if (binaryNode) {
-            bool leftHasNonLiteral = binaryNode->left && containsNonLiteral(*binaryNode->left);
-            bool rightHasNonLiteral = binaryNode->right && containsNonLiteral(*binaryNode->right);
-            return leftHasNonLiteral || rightHasNonLiteral;
-        }
-    }
-    return false;
+bool Semantic::containsNonLiteral(const ASTNode& node)
+{
+    bool found = false;
+    m_walker.walk(
+        node,
+        [&found](const ASTNode& n)
+        {
+            found |= n.token.type == LexerTokenType::VarToken;
+            return !found && n.getType() == NodeType::BinaryOperation;
+        },
+        [](const ASTNode&) {});
+    return found;
 }
 
-void Semantic::ensureTypeMatch(InferredType left, InferredType right, const LexerToken& token) const
+Expected<void> Semantic::ensureTypeMatch(InferredType left, InferredType right, const LexerToken& token) const
 {
     if (left != right)
     {
-        throw Error("Type mismatch in operation", token.location, ErrorType::SEMANTIC);
+        return Unexpected(Error("Type mismatch in operation", token.offset, ErrorType::SEMANTIC));
     }
+    return {};
 }
-InferredType Semantic::inferTypeFromVariable(const ASTNode& node)
+Expected<InferredType> Semantic::inferTypeFromVariable(const ASTNode& node)
 {
-    auto type = ScopedSymbolTable::getInstance().lookup(std::string(node.token.value));
+    auto type = m_symbols.lookup(getVariableId(node));
     if (!type)
     {
-        throw Error("Variable not defined", node.token.location, ErrorType::SEMANTIC);
+        return Unexpected(Error("Variable not defined", node.token.offset, ErrorType::SEMANTIC));
     }
     return *type;
 }
@@ -145,97 +295,119 @@ bool Semantic::isComparisonOp(const BinaryNode& node)
             node.token.type == LexerTokenType::GreaterEqualToken || node.token.type == LexerTokenType::GreaterToken);
 }
 
-InferredType Semantic::inferTypeFromOperation(const BinaryNode& node)
+Expected<InferredType>
+Semantic::inferTypeFromOperation(const BinaryNode& node, InferredType leftType, InferredType rightType)
 {
-    if (!node.left || !node.right)
-    {
-        throw Error("Unbalanced expression, missing operand", node.token.location, ErrorType::SEMANTIC);
-    }
-
-    if (node.token.type == LexerTokenType::DivideToken)
-    {
-        checkDivisionByZero(*node.right);
-    }
-
-    InferredType leftType  = inferType(*node.left);
-    InferredType rightType = inferType(*node.right);
-    ensureTypeMatch(leftType, rightType, node.token);
+    if (auto matched = ensureTypeMatch(leftType, rightType, node.token); !matched)
+        return Unexpected(matched.error());
     if ((leftType == InferredType::BOOL && rightType == InferredType::BOOL) && isComparisonOp(node))
     {
-        throw Error("Invalid operation: cannot compare boolean values using <, >, <=, or >=",
-                    node.token.location,
-                    ErrorType::SEMANTIC);
+        return Unexpected(Error("Invalid operation: cannot compare boolean values using <, >, <=, or >=",
+                                node.token.offset,
+                                ErrorType::SEMANTIC));
     }
     return leftType;
 }
 
-void Semantic::analyzeConditionalOperation(const ConditionalNode& node)
+Expected<void> Semantic::analyzeConditionalOperation(const ConditionalNode& node)
 {
     if (!isValidConditionType(node.condition->token))
     {
-        throw Error("Expected a boolean expression", node.condition->token.location);
+        return Unexpected(Error("Expected a boolean expression", node.condition->token.offset));
     }
-    inferType(*node.condition);
-    analyzeBlockOperation(*node.ifNode);
+    if (auto type = inferType(*node.condition); !type)
+        return Unexpected(type.error());
+    if (m_emitter)
+        m_emitter->emitIf();
+    if (auto analyzed = analyzeBlockOperation(*node.ifNode); !analyzed)
+        return analyzed;
     if (node.elseNode)
     {
-        analyzeBlockOperation(*node.elseNode);
+        if (m_emitter)
+            m_emitter->emitElse();
+        if (auto analyzed = analyzeBlockOperation(*node.elseNode); !analyzed)
+            return analyzed;
     }
+    if (m_emitter)
+        m_emitter->emitEnd();
+    return {};
 }
 
-void Semantic::analyzeBlockOperation(const TreeNode& node)
+Expected<void> Semantic::analyzeBlockOperation(const TreeNode& node)
 {
-    auto& symbolTable = ScopedSymbolTable::getInstance();
+    auto& symbolTable = m_symbols;
     symbolTable.enterScope();
 
+    Expected<void> analyzed;
     if (node.token.type == LexerTokenType::PrintToken)
     {
-        analyzePrintOperation(node);
+        analyzed = analyzePrintOperation(node);
     }
     else
     {
-
         for (const auto& statement : node.children)
         {
-            analyzeTree(*statement);
+            analyzed = analyze(*statement);
+            if (!analyzed)
+                break;
         }
     }
 
+    // Compilation goes on after an error, so the scope must not outlive the block either way
+    const bool declared = symbolTable.declaresAny();
     symbolTable.exitScope();
+    // Variables of the block are gone, and a later one of the same name may have another type
+    if (declared)
+        m_sharedTypes.clear();
+    return analyzed;
 }
 
-void Semantic::analyzePrintOperation(const TreeNode& node)
+Expected<void> Semantic::analyzePrintOperation(const TreeNode& node)
 {
     if (node.children.empty())
     {
-        throw Error("Print statement requires at least one argument", node.token.location, ErrorType::SEMANTIC);
+        return Unexpected(
+            Error("Print statement requires at least one argument", node.token.offset, ErrorType::SEMANTIC));
     }
 
     // Ensure each child of the print statement is a valid expression.
     for (const auto& child : node.children)
     {
-        analyzePrintExpression(*child); // Analyze the child expression.
+        if (auto analyzed = analyzePrintExpression(*child); !analyzed) // Analyze the child expression.
+            return analyzed;
     }
+    if (m_emitter)
+        m_emitter->emitPrint();
+    return {};
 }
 
-void Semantic::analyzePrintExpression(const ASTNode& node)
+Expected<void> Semantic::analyzePrintExpression(const ASTNode& node)
 {
 
     if (isSimpleLiteralOrVariable(node))
     {
-        return;
+        if (m_emitter)
+            emitTree(node);
+        return {};
     }
     else if (node.getType() == NodeType::BinaryOperation)
     {
         const auto& binaryNode = static_cast<const BinaryNode&>(node);
         if (binaryNode.left && binaryNode.right)
         {
-            ensureTypeMatch(inferType(*binaryNode.left), inferType(*binaryNode.right), binaryNode.token);
+            if (auto matched = inferOperandTypes(binaryNode); !matched)
+                return matched;
+            if (m_emitter)
+                m_emitter->emit(binaryNode);
+            return {};
         }
+        if (m_emitter)
+            emitTree(node);
+        return {};
     }
     else
     {
-        throw Error("Invalid expression in print statement", node.token.location, ErrorType::SEMANTIC);
+        return Unexpected(Error("Invalid expression in print statement", node.token.offset, ErrorType::SEMANTIC));
     }
 }
 
@@ -246,17 +418,20 @@ bool Semantic::isSimpleLiteralOrVariable(const ASTNode& node) const
             node.token.type == LexerTokenType::VarToken);
 }
 
-void Semantic::checkDivisionByZero(const ASTNode& node)
+Expected<void> Semantic::checkDivisionByZero(const ASTNode& node)
 {
-    if (node.token.type == LexerTokenType::IntToken && std::stoi(std::string(node.token.value)) == 0)
+    // Literals are checked by their digits or with strtof, which cannot throw on out-of-range values
+    const std::string value(node.token.value);
+    if (node.token.type == LexerTokenType::IntToken && value.find_first_not_of('0') == std::string::npos)
     {
-        throw Error("Division by zero", node.token.location, ErrorType::SEMANTIC);
+        return Unexpected(Error("Division by zero", node.token.offset, ErrorType::SEMANTIC));
     }
     else if (node.token.type == LexerTokenType::FloatToken &&
-             std::abs(std::stof(std::string(node.token.value))) < std::numeric_limits<float>::epsilon())
+             std::abs(std::strtof(value.c_str(), nullptr)) < std::numeric_limits<float>::epsilon())
     {
-        throw Error("Division by zero", node.token.location, ErrorType::SEMANTIC);
+        return Unexpected(Error("Division by zero", node.token.offset, ErrorType::SEMANTIC));
     }
+    return {};
 }
 
 bool Semantic::isValidConditionType(const LexerToken& token) const
@@ -272,9 +447,9 @@ bool Semantic::isValidBinaryType(const LexerToken& token) const
             token.type == LexerTokenType::MultiplyToken || token.type == LexerTokenType::DivideToken);
 }
 
-std::string Semantic::getVariableName(const ASTNode& node) const
+SymbolId Semantic::getVariableId(const ASTNode& node)
 {
-    return std::string(node.token.value);
+    return m_symbols.idOf(node.token);
 }
 
 nlohmann::json Semantic::tableToJson(const symbolTable& table)
@@ -314,5 +489,5 @@ constexpr std::string_view Semantic::getInferredTypeDescription(const InferredTy
 
 void Semantic::addSymbolTableToOutput()
 {
-    m_output.getJson()["SymbolTable"] = tableToJson(ScopedSymbolTable::getInstance().getSymbolTable());
+    m_output.getJson()["SymbolTable"] = tableToJson(m_symbols.getSymbolTable());
 }
\ No newline at end of file
@@ -1,46 +1,81 @@
 #pragma once
 
+#include "AstWalker.hpp"
+#include "CodeEmitter.hpp"
 #include "CompilerOutput.hpp"
+#include "Expected.hpp"
 #include "SymbolTable.hpp"
+#include <cstdint>
+#include <optional>
+#include <unordered_map>
+#include <vector>
 
 class Semantic
 {
   public:
-    explicit Semantic(CompilerOutput& output) : m_output(output) {}
+    //! Declares the variables it analyzes in `symbols`, which must outlive it
+    Semantic(CompilerOutput& output, ScopedSymbolTable& symbols) : m_output(output), m_symbols(symbols) {}
 
-    void analyzeTree(const ASTNode& node);
-    void addSymbolTableToOutput();
+    //! Checks one statement, returning the first error in it
+    Expected<void> analyze(const ASTNode& node);
+    //! Checks one statement and hands its code to `emitter` in the same walk
+    Expected<void> analyze(const ASTNode& node, CodeEmitter& emitter);
+#if !defined(CURIOUSX_NO_EXCEPTIONS)
+    //! Throwing form of analyze()
+    void           analyzeTree(const ASTNode& node);
+#endif
+    void           addSymbolTableToOutput();
+    //! Forgets the types inferred for shared subtrees, once their hashes may be given to other
+    //! subtrees (SubtreeTable::clear())
+    void           forgetSharedTypes() { m_sharedTypes.clear(); }
 
   private:
-    // Analysis methods
-    void analyzeBinaryOperation(const BinaryNode& node);
-    void analyzeConditionalOperation(const ConditionalNode& node);
-    void analyzeBlockOperation(const TreeNode& node);
-    void analyzeAssignment(const BinaryNode& node);
-    void analyzeExpression(const BinaryNode& node);
-    void analyzePrintOperation(const TreeNode& node);
-    void analyzePrintExpression(const ASTNode& node);
-    
+    // Analysis methods; errors are returned, since invalid input is common and unwinding is costly
+    Expected<void> analyzeBinaryOperation(const BinaryNode& node);
+    Expected<void> analyzeConditionalOperation(const ConditionalNode& node);
+    Expected<void> analyzeBlockOperation(const TreeNode& node);
+    Expected<void> analyzeAssignment(const BinaryNode& node);
+    Expected<void> analyzeExpression(const BinaryNode& node);
+    Expected<void> analyzePrintOperation(const TreeNode& node);
+    Expected<void> analyzePrintExpression(const ASTNode& node);
 
     // Type inference methods
-    InferredType inferType(const ASTNode& node);
-    InferredType inferTypeFromVariable(const ASTNode& node);
-    InferredType inferTypeFromOperation(const BinaryNode& node);
+    Expected<InferredType> inferType(const ASTNode& root);
+    Expected<InferredType> inferTypeFromLiteral(const ASTNode& node);
+    Expected<InferredType> inferTypeFromVariable(const ASTNode& node);
+    Expected<InferredType> inferTypeFromOperation(const BinaryNode& node, InferredType leftType, InferredType rightType);
+    Expected<void>         inferOperandTypes(const BinaryNode& node);
+    //! Type inferred earlier for a hash-consed subtree equal to `node`, if any
+    std::optional<InferredType> sharedType(const ASTNode& node) const;
+    //! Records `type` on `node`, whose operands are annotated already (BinaryNode::type)
+    void                        annotate(const ASTNode& node, InferredType type);
+    void                        annotateShared(const BinaryNode& root, InferredType type);
+    static bool                 readsVariable(const ASTNode* node);
+    //! Emits every node of `root`, which is annotated already
+    void                        emitTree(const ASTNode& root);
 
     // Validation methods
-    void checkDivisionByZero(const ASTNode& node);
-    bool isValidConditionType(const LexerToken& token) const;
-    bool isValidBinaryType(const LexerToken& token) const;
-    bool containsNonLiteral(const ASTNode& node) const;
-    bool isSimpleLiteralOrVariable(const ASTNode& node) const;
-    void ensureTypeMatch(InferredType left, InferredType right, const LexerToken& token) const;
+    Expected<void> checkDivisionByZero(const ASTNode& node);
+    bool           isValidConditionType(const LexerToken& token) const;
+    bool           isValidBinaryType(const LexerToken& token) const;
+    bool           containsNonLiteral(const ASTNode& node);
+    bool           isSimpleLiteralOrVariable(const ASTNode& node) const;
+    Expected<void> ensureTypeMatch(InferredType left, InferredType right, const LexerToken& token) const;
 
     // Helper methods
-    std::string                getVariableName(const ASTNode& node) const;
+    SymbolId                   getVariableId(const ASTNode& node);
     nlohmann::json             tableToJson(const symbolTable& table);
     constexpr std::string_view getInferredTypeDescription(const InferredType& t);
     bool                       isComparisonOp(const BinaryNode& node);
 
     // Member variables
-    CompilerOutput& m_output;
+    CompilerOutput&           m_output;
+    ScopedSymbolTable&        m_symbols;
+    CodeEmitter*              m_emitter = nullptr; // set while a statement is analyzed and generated at once
+    AstWalker                 m_walker;
+    std::vector<InferredType> m_types; // operand types of the expression being inferred
+    // Types of hash-consed subtrees (BinaryNode::hash) since the last scope ended. Until it is cleared,
+    // the SubtreeTable never gives one hash to two different subtrees, so the hash alone identifies
+    // the subtree.
+    std::unordered_map<std::uint64_t, InferredType> m_sharedTypes;
 };
\ No newline at end of file
@@ -1,34 +1,58 @@
 #pragma once
 
+#include <algorithm>
 #include <optional>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
+#include "Expected.hpp"
+#include "IdentifierTable.hpp"
 #include "Node.hpp"
 
 
 
-enum class InferredType
-{
-    INTEGER,
-    FLOAT,
-    STRING,
-    BOOL
-};
-
 struct SymbolInfo
 {
     InferredType type;
     LexerToken   token;
 };
 
+//! Export form of the scopes, innermost last, keyed by name
 using symbolTable = std::vector<std::unordered_map<std::string, SymbolInfo>>;
 
+//! Variables of one compilation. The Compiler owns it and lends it to Semantic, which declares the
+//! variables, and to WasmGen, which looks up their types; compilations never share a table.
+//!
+//! Variables are keyed by their SymbolId in identifiers(). Each ID has a shadow stack of its
+//! declarations, innermost on top, so lookup() reads one entry however deep the scopes are. An undo
+//! log records which IDs each open scope declared: enterScope() only remembers the log's length, and
+//! exitScope() pops the stacks of the IDs logged since, so a scope that declares nothing costs no
+//! allocation and no work beyond that.
 class ScopedSymbolTable
 {
   private:
-    symbolTable scopes;
-    int                                                      currentScopeLevel;
+    struct Declaration
+    {
+        SymbolInfo info;
+        int        level; // scope it was declared in
+    };
+
+    std::vector<std::vector<Declaration>> shadows;    // by SymbolId
+    std::vector<SymbolId>                 undoLog;    // IDs declared in the open scopes, in order
+    std::vector<size_t>                   scopeMarks; // undoLog length when each scope was entered
+    int                                   currentScopeLevel;
+    IdentifierTable                       names;
+
+    std::optional<SymbolId> find(std::string_view name) const { return names.find(name); }
+
+    //! Innermost declaration of `id`, if any
+    const Declaration* top(SymbolId id) const
+    {
+        return id < shadows.size() && !shadows[id].empty() ? &shadows[id].back() : nullptr;
+    }
+
+  public:
     ScopedSymbolTable() : currentScopeLevel(-1)
     {
         enterScope(); // Create global scope
@@ -36,15 +60,14 @@ class ScopedSymbolTable
     ScopedSymbolTable(const ScopedSymbolTable&)            = delete;
     ScopedSymbolTable& operator=(const ScopedSymbolTable&) = delete;
 
-  public:
-    static ScopedSymbolTable& getInstance()
-    {
-        static ScopedSymbolTable instance;
-        return instance;
-    }
+    //! Names of the variables; the Parser interns the tokens of this compilation into it
+    IdentifierTable&       identifiers() { return names; }
+    const IdentifierTable& identifiers() const { return names; }
+    SymbolId               idOf(const LexerToken& token) { return names.idOf(token); }
+
     void enterScope()
     {
-        scopes.emplace_back();
+        scopeMarks.push_back(undoLog.size());
         currentScopeLevel++;
     }
 
@@ -52,65 +75,99 @@ class ScopedSymbolTable
     {
         if (currentScopeLevel > 0)
         {
-            scopes.pop_back();
+            for (size_t i = scopeMarks.back(); i < undoLog.size(); ++i)
+                shadows[undoLog[i]].pop_back();
+            undoLog.resize(scopeMarks.back());
+            scopeMarks.pop_back();
             currentScopeLevel--;
         }
     }
 
-    void insert(const std::string& name, InferredType type, const LexerToken& declarationToken)
+    //! Whether the current scope declared anything yet
+    bool declaresAny() const { return undoLog.size() > scopeMarks.back(); }
+
+    //! Declares `id` in the current scope; redeclaring it there is an error
+    Expected<void> tryInsert(SymbolId id, InferredType type, const LexerToken& declarationToken)
     {
-        auto& currentScope = scopes[currentScopeLevel];
-        if (currentScope.find(name) != currentScope.end())
+        if (auto declared = top(id); declared && declared->level == currentScopeLevel)
         {
-            throw Error("Unable to infer type", declarationToken.location, ErrorType::SEMANTIC);
+            return Unexpected(Error("Unable to infer type", declarationToken.offset, ErrorType::SEMANTIC));
         }
-        currentScope[name] = SymbolInfo{type, declarationToken};
+        if (id >= shadows.size())
+            shadows.resize(id + 1);
+        shadows[id].push_back({SymbolInfo{type, declarationToken}, currentScopeLevel});
+        undoLog.push_back(id);
+        return {};
     }
 
-    bool contains(const std::string& name) const { return lookup(name).has_value(); }
+    Expected<void> tryInsert(std::string_view name, InferredType type, const LexerToken& declarationToken)
+    {
+        return tryInsert(names.intern(name), type, declarationToken);
+    }
 
-    std::optional<InferredType> lookup(const std::string& name) const
+#if !defined(CURIOUSX_NO_EXCEPTIONS)
+    //! Throwing form of tryInsert()
+    void insert(std::string_view name, InferredType type, const LexerToken& declarationToken)
     {
-        for (int i = currentScopeLevel; i >= 0; i--)
-        {
-            auto it = scopes[i].find(name);
-            if (it != scopes[i].end())
-            {
-                return it->second.type;
-            }
-        }
+        if (auto inserted = tryInsert(name, type, declarationToken); !inserted)
+            throw inserted.error();
+    }
+#endif
+
+    bool contains(std::string_view name) const { return lookup(name).has_value(); }
+
+    std::optional<InferredType> lookup(SymbolId id) const
+    {
+        if (auto declared = top(id))
+            return declared->info.type;
         return std::nullopt;
     }
 
-    bool remove(const std::string& name)
+    std::optional<InferredType> lookup(std::string_view name) const
     {
-        auto& currentScope = scopes[currentScopeLevel];
-        return currentScope.erase(name) > 0;
+        auto id = find(name);
+        return id ? lookup(*id) : std::nullopt;
+    }
+
+    bool remove(std::string_view name)
+    {
+        auto id = find(name);
+        if (!id || !top(*id) || top(*id)->level != currentScopeLevel)
+            return false;
+        shadows[*id].pop_back();
+        // Declarations are unique within a scope, so the scope's log holds the ID once
+        auto logged = std::find(undoLog.begin() + static_cast<std::ptrdiff_t>(scopeMarks.back()), undoLog.end(), *id);
+        undoLog.erase(logged);
+        return true;
     }
 
     void clear()
     {
-        scopes.clear();
+        shadows.clear();
+        undoLog.clear();
+        scopeMarks.clear();
         currentScopeLevel = -1;
         enterScope();
     }
 
     int getCurrentScopeLevel() const { return currentScopeLevel; }
 
-    std::optional<InferredType> lookupCurrentScope(const std::string& name) const
+    std::optional<InferredType> lookupCurrentScope(std::string_view name) const
     {
-        for (int i = currentScopeLevel; i >= 0; i--)
-        {
-            auto it = scopes[currentScopeLevel].find(name);
-            if (it != scopes[currentScopeLevel].end())
-            {
-                return it->second.type;
-            }
-        }
-        return std::nullopt;
+        auto id = find(name);
+        if (!id || !top(*id) || top(*id)->level != currentScopeLevel)
+            return std::nullopt;
+        return top(*id)->info.type;
     }
 
-    bool isFloatType(std::string_view varName) const { return lookup(std::string(varName)) == InferredType::FLOAT; }
+    bool isFloatType(std::string_view varName) const { return lookup(varName) == InferredType::FLOAT; }
 
-    const symbolTable getSymbolTable() { return scopes; }
+    const symbolTable getSymbolTable()
+    {
+        symbolTable table(static_cast<size_t>(currentScopeLevel + 1));
+        for (SymbolId id = 0; id < shadows.size(); ++id)
+            for (const auto& declaration : shadows[id])
+                table[static_cast<size_t>(declaration.level)].emplace(std::string(names.name(id)), declaration.info);
+        return table;
+    }
 };
\ No newline at end of file
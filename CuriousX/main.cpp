@@ -1,15 +1,18 @@
 
 #include "Compiler.hpp"
 #include "CompilerOutput.hpp"
+#include "SourceFile.hpp"
+#include "SourceStream.hpp"
+#include <fstream>
 #include <iostream>
 #include <sstream>
 
-std::string processFileContent(const std::string& content)
+std::string processFileContent(const std::string& content, bool emitLexer)
 {
     CompilerOutput output;
-    Compiler       compiler(content, output);
+    Compiler       compiler(content, output, {.emitLexer = emitLexer});
     compiler.compile();
-    return output.getJson().dump();
+    return output.dump();
 }
 
 #ifdef __EMSCRIPTEN__
@@ -22,15 +25,71 @@ EMSCRIPTEN_BINDINGS(my_module)
 int main(int argc, const char* argv[])
 {
 
-    if (argc != 3)
+    CompilerOptions options;
+    bool            validArgs = argc >= 3;
+    bool            binaryAST = false;
+    for (int i = 3; i < argc; ++i)
     {
-        std::cout << "Usage: " << argv[0] << " <input_file> <output_file>" << std::endl;
+        if (std::string_view(argv[i]) == "--no-lexer")
+            options.emitLexer = false;
+        else if (std::string_view(argv[i]) == "--no-ast")
+            options.emitAST = false;
+        else if (std::string_view(argv[i]) == "--pipelined")
+            options.pipelined = true;
+        else if (std::string_view(argv[i]) == "--share-subtrees")
+            options.shareSubtrees = true;
+        else if (std::string_view(argv[i]) == "--fuse-codegen")
+            options.fuseCodegen = true;
+        else if (std::string_view(argv[i]) == "--fold-constants")
+            options.foldConstants = true;
+        else if (std::string_view(argv[i]) == "--binary-ast")
+            binaryAST = true;
+        else
+            validArgs = false;
+    }
+    // Streamed input does not keep its AST
+    if (!validArgs || (binaryAST && std::string_view(argv[1]) == "-"))
+    {
+        std::cout << "Usage: " << argv[0]
+                  << " <input_file> <output_file> [--no-lexer] [--no-ast] [--pipelined] [--share-subtrees]"
+                     " [--fuse-codegen] [--fold-constants] [--binary-ast]"
+                  << std::endl;
+        return 1;
+    }
+    if (binaryAST)
+    {
+        // The JSON output is only written when there are errors to report
+        options.emitLexer     = false;
+        options.emitAST       = false;
+        options.emitBinaryAST = true;
     }
 
     CompilerOutput output(argv[1]);
-    auto           content = output.readFromFile();
-    Compiler       compiler(content, output);
-    compiler.compile();
+    if (std::string_view(argv[1]) == "-")
+    {
+        // Standard input may be an unbounded pipe; compile it statement by statement. The Lexer and AST
+        // sections still grow with the input, so --no-lexer --no-ast keeps memory bounded.
+        SourceStream stream = SourceStream::standardInput();
+        Compiler     compiler(output, options);
+        compiler.compile(stream);
+    }
+    else
+    {
+        SourceFile source(argv[1]);
+        if (source.view().size() >= Lexer::parallelThreshold)
+            options.lexerPool = &ThreadPool::shared();
+        Compiler compiler(source.view(), output, options);
+        compiler.compile();
+        // A program without statements compiles to nothing but still has an AST; only errors fall back to JSON
+        if (binaryAST)
+        {
+            if (const auto encoded = compiler.binaryAST(); !encoded.empty())
+            {
+                std::ofstream(argv[2], std::ios::binary) << encoded;
+                return 0;
+            }
+        }
+    }
     output.writeToFile(argv[2]);
 
     return 0;
@@ -0,0 +1,108 @@
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////
+/// Generators for the synthetic programs the phase benchmarks run over.
+/// Every program compiles cleanly; `statements` counts nested statements
+/// too, so statements/s is comparable across shapes.
+///////////////////////////////////////////////////////////////////////////
+
+#include <benchmark/benchmark.h>
+#include <string>
+#include <string_view>
+
+enum class Shape
+{
+    ManyVariables,
+    LongExpression,
+    DeepIf,
+    PrintHeavy
+};
+
+struct SyntheticProgram
+{
+    std::string source;
+    size_t      statements = 0;
+};
+
+inline std::string_view shapeName(Shape shape)
+{
+    switch (shape)
+    {
+    case Shape::ManyVariables:
+        return "many_variables";
+    case Shape::LongExpression:
+        return "long_expression";
+    case Shape::DeepIf:
+        return "deep_if";
+    case Shape::PrintHeavy:
+        return "print_heavy";
+    }
+    return "";
+}
+
+inline SyntheticProgram makeProgram(Shape shape, size_t size)
+{
+    SyntheticProgram program;
+    auto&            src = program.source;
+    switch (shape)
+    {
+    case Shape::ManyVariables:
+        // `size` assignments, each reading the one before it
+        src += "v0 = 1\n";
+        for (size_t i = 1; i < size; ++i)
+            src += "v" + std::to_string(i) + " = v" + std::to_string(i - 1) + " * 2 + " + std::to_string(i) + "\n";
+        program.statements = size;
+        break;
+    case Shape::LongExpression:
+        // A handful of assignments, each a chain of `size` terms
+        for (size_t line = 0; line < 8; ++line)
+        {
+            src += "e" + std::to_string(line) + " = 1";
+            for (size_t i = 1; i < size; ++i)
+                src += (i % 3 == 0 ? " * " : i % 3 == 1 ? " + " : " - ") + std::to_string(i % 97 + 1);
+            src += "\n";
+        }
+        program.statements = 8;
+        break;
+    case Shape::DeepIf:
+        // `size` nested conditionals around a single print
+        src += "d = 1\n";
+        for (size_t i = 0; i < size; ++i)
+            src += std::string(i * 4, ' ') + "if (d > " + std::to_string(i % 10) + ") {\n";
+        src += std::string(size * 4, ' ') + "print(d)\n";
+        for (size_t i = size; i-- > 0;)
+            src += std::string(i * 4, ' ') + "}\n";
+        program.statements = size + 2;
+        break;
+    case Shape::PrintHeavy:
+        // `size` prints alternating between expressions and string literals
+        src += "p = 3\n";
+        for (size_t i = 0; i < size; ++i)
+            src += i % 2 ? "print(\"line " + std::to_string(i) + "\")\n" : "print(p + " + std::to_string(i) + ")\n";
+        program.statements = size + 1;
+        break;
+    }
+    return program;
+}
+
+//! Registers the (shape, size) grid every phase benchmark runs over
+inline void syntheticInputs(benchmark::internal::Benchmark* bench)
+{
+    bench->ArgNames({"shape", "size"});
+    for (auto shape : {Shape::ManyVariables, Shape::LongExpression, Shape::PrintHeavy})
+    {
+        bench->Args({static_cast<int64_t>(shape), 256});
+        bench->Args({static_cast<int64_t>(shape), 4096});
+    }
+    bench->Args({static_cast<int64_t>(Shape::DeepIf), 16});
+    bench->Args({static_cast<int64_t>(Shape::DeepIf), 128});
+}
+
+//! Reports bytes/s and statements/s for a benchmark that processed `program` once per iteration
+inline void reportThroughput(benchmark::State& state, const SyntheticProgram& program)
+{
+    state.SetLabel(std::string(shapeName(static_cast<Shape>(state.range(0)))));
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(program.source.size()));
+    state.counters["statements"] =
+        benchmark::Counter(static_cast<double>(state.iterations() * program.statements), benchmark::Counter::kIsRate);
+}
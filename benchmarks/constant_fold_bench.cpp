@@ -0,0 +1,54 @@
+#include "Compiler.hpp"
+#include "SyntheticSources.hpp"
+#include <benchmark/benchmark.h>
+
+///////////////////////////////////////////////////////////////////////////
+/// Compiles a program of constant expressions and variables assigned
+/// them with CompilerOptions::foldConstants off (fold:0) and on (fold:1).
+/// The instructions counter is the size of the generated code, which is
+/// what a wasm engine has to compile in turn.
+///////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+//! `size` groups of statements, each computing from the one before it
+SyntheticProgram makeConstantProgram(size_t size)
+{
+    SyntheticProgram program;
+    program.source = "k0 = 12\nh0 = 0.5\n";
+    for (size_t i = 1; i < size; ++i)
+    {
+        const auto n = std::to_string(i), previous = std::to_string(i - 1);
+        program.source += "k" + n + " = k" + previous + " * 3 + (7 - 2) * 4\n";
+        program.source += "h" + n + " = h" + previous + " * 0.5 + 1.25\n";
+        program.source += "print(k" + n + " / 2 - 1)\n";
+    }
+    program.statements = 3 * size - 1;
+    return program;
+}
+
+void compileConstants(benchmark::State& state)
+{
+    const auto      program = makeConstantProgram(static_cast<size_t>(state.range(1)));
+    CompilerOptions options;
+    options.emitLexer     = false;
+    options.emitAST       = false;
+    options.foldConstants = state.range(0) != 0;
+    size_t instructions   = 0;
+    for (auto _ : state)
+    {
+        CompilerOutput output;
+        benchmark::DoNotOptimize(Compiler(program.source, output, options).compile());
+        instructions = output.getJson()["Gen"][0].size();
+    }
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(program.source.size()));
+    state.counters["statements"] =
+        benchmark::Counter(static_cast<double>(state.iterations() * program.statements), benchmark::Counter::kIsRate);
+    state.counters["instructions"] = static_cast<double>(instructions);
+}
+} // namespace
+
+BENCHMARK(compileConstants)
+    ->Name("ConstantFolding/EndToEnd")
+    ->ArgNames({"fold", "size"})
+    ->ArgsProduct({{0, 1}, {256, 4096}});
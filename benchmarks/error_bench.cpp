@@ -0,0 +1,192 @@
+#include "Compiler.hpp"
+#include "SyntheticSources.hpp"
+#include <benchmark/benchmark.h>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////
+/// Error-heavy inputs, as an editor sends them while a line is being
+/// typed. Each benchmark pair runs the same work through a phase's
+/// throwing entry point and through its Expected one, so the cost of
+/// unwinding shows up as the difference between the two.
+///////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+//! `size` statements cycling through a syntax error, a type mismatch and a valid assignment
+SyntheticProgram makeInvalidProgram(size_t size)
+{
+    SyntheticProgram program;
+    for (size_t i = 0; i < size; ++i)
+    {
+        const auto n = std::to_string(i);
+        switch (i % 3)
+        {
+        case 0:
+            program.source += "a" + n + " = (" + n + " + \n";
+            break;
+        case 1:
+            program.source += "b" + n + " = \"text\" + " + n + "\n";
+            break;
+        default:
+            program.source += "c" + n + " = " + n + " * 2\n";
+            break;
+        }
+    }
+    program.statements = size;
+    return program;
+}
+
+SyntheticProgram programFor(const benchmark::State& state)
+{
+    return makeInvalidProgram(static_cast<size_t>(state.range(0)));
+}
+
+void reportErrorThroughput(benchmark::State& state, const SyntheticProgram& program)
+{
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(program.source.size()));
+    state.counters["statements"] =
+        benchmark::Counter(static_cast<double>(state.iterations() * program.statements), benchmark::Counter::kIsRate);
+}
+
+// Parses every statement, resuming after each error the way Compiler::compileStatements does
+template <typename ParseOne>
+size_t parseAll(Parser& parser, ParseOne&& parseOne)
+{
+    size_t     errors = 0;
+    LexerToken token{"Program", noSourceOffset, LexerTokenType::ProgramToken};
+    parser.advanceToken(token);
+    while (token.type != LexerTokenType::Eof)
+    {
+        if (!parseOne(token))
+        {
+            ++errors;
+            parser.synchronize(token);
+        }
+        parser.advancePastNewlines(token);
+    }
+    return errors;
+}
+
+void parserThrowing(benchmark::State& state)
+{
+    const auto     program = programFor(state);
+    CompilerOutput output;
+    Arena          arena;
+    for (auto _ : state)
+    {
+        arena.reset();
+        Parser parser(program.source, output, arena);
+        benchmark::DoNotOptimize(parseAll(parser,
+                                          [&](LexerToken& token)
+                                          {
+                                              try
+                                              {
+                                                  return parser.parseStatement(token) != nullptr;
+                                              }
+                                              catch (const Error&)
+                                              {
+                                                  return false;
+                                              }
+                                          }));
+    }
+    reportErrorThroughput(state, program);
+}
+
+void parserExpected(benchmark::State& state)
+{
+    const auto     program = programFor(state);
+    CompilerOutput output;
+    Arena          arena;
+    for (auto _ : state)
+    {
+        arena.reset();
+        Parser parser(program.source, output, arena);
+        benchmark::DoNotOptimize(
+            parseAll(parser, [&](LexerToken& token) { return parser.tryParseStatement(token).has_value(); }));
+    }
+    reportErrorThroughput(state, program);
+}
+
+// The statements of the program that parse, for the semantic benchmarks
+std::vector<ASTNode*> parsedStatements(Parser& parser)
+{
+    std::vector<ASTNode*> nodes;
+    parseAll(parser,
+             [&](LexerToken& token)
+             {
+                 auto node = parser.tryParseStatement(token);
+                 if (node && *node)
+                     nodes.push_back(*node);
+                 return node.has_value();
+             });
+    return nodes;
+}
+
+void semanticThrowing(benchmark::State& state)
+{
+    const auto        program = programFor(state);
+    CompilerOutput    output;
+    Arena             arena;
+    Parser            parser(program.source, output, arena);
+    const auto        nodes = parsedStatements(parser);
+    ScopedSymbolTable symbols;
+    Semantic          semantic(output, symbols);
+    for (auto _ : state)
+    {
+        symbols.clear();
+        size_t errors = 0;
+        for (const auto& node : nodes)
+        {
+            try
+            {
+                semantic.analyzeTree(*node);
+            }
+            catch (const Error&)
+            {
+                ++errors;
+            }
+        }
+        benchmark::DoNotOptimize(errors);
+    }
+    reportErrorThroughput(state, program);
+}
+
+void semanticExpected(benchmark::State& state)
+{
+    const auto        program = programFor(state);
+    CompilerOutput    output;
+    Arena             arena;
+    Parser            parser(program.source, output, arena);
+    const auto        nodes = parsedStatements(parser);
+    ScopedSymbolTable symbols;
+    Semantic          semantic(output, symbols);
+    for (auto _ : state)
+    {
+        symbols.clear();
+        size_t errors = 0;
+        for (const auto& node : nodes)
+            errors += !semantic.analyze(*node);
+        benchmark::DoNotOptimize(errors);
+    }
+    reportErrorThroughput(state, program);
+}
+
+void compilerErrorHeavy(benchmark::State& state)
+{
+    const auto      program = programFor(state);
+    CompilerOptions options;
+    options.maxErrors = program.statements;
+    for (auto _ : state)
+    {
+        CompilerOutput output;
+        benchmark::DoNotOptimize(Compiler(program.source, output, options).compile());
+    }
+    reportErrorThroughput(state, program);
+}
+} // namespace
+
+BENCHMARK(parserThrowing)->Name("Errors/Parser/Throwing")->ArgName("size")->Arg(256)->Arg(4096);
+BENCHMARK(parserExpected)->Name("Errors/Parser/Expected")->ArgName("size")->Arg(256)->Arg(4096);
+BENCHMARK(semanticThrowing)->Name("Errors/Semantic/Throwing")->ArgName("size")->Arg(256)->Arg(4096);
+BENCHMARK(semanticExpected)->Name("Errors/Semantic/Expected")->ArgName("size")->Arg(256)->Arg(4096);
+BENCHMARK(compilerErrorHeavy)->Name("Errors/Compiler/EndToEnd")->ArgName("size")->Arg(256)->Arg(4096);
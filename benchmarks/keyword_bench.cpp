@@ -0,0 +1,62 @@
+#include "Lexer/Keywords.hpp"
+#include <benchmark/benchmark.h>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+// Identifier mix with roughly one keyword in four, similar to generated scripts
+std::vector<std::string> makeIdentifiers(size_t count)
+{
+    static const std::vector<std::string> pool = {
+        "print", "if", "else", "true", "false", "x", "y", "total", "counter", "value1",
+        "tmp",   "a",  "b",    "idx",  "sum",   "p", "i", "elsewhere", "printer", "Print",
+    };
+    std::mt19937                          rng(42);
+    std::uniform_int_distribution<size_t> pick(0, pool.size() - 1);
+
+    std::vector<std::string> words;
+    words.reserve(count);
+    for (size_t i = 0; i < count; ++i)
+        words.push_back(pool[pick(rng)]);
+    return words;
+}
+
+// The function-static map the lexer used before the perfect hash
+LexerTokenType classifyWithMap(std::string_view word)
+{
+    static const std::unordered_map<std::string_view, LexerTokenType> keywords = {
+        {"print", LexerTokenType::PrintToken},
+        {"Print", LexerTokenType::PrintToken},
+        {"if", LexerTokenType::IfToken},
+        {"else", LexerTokenType::ElseToken},
+        {"true", LexerTokenType::BoolToken},
+        {"false", LexerTokenType::BoolToken}};
+
+    if (auto it = keywords.find(word); it != keywords.end())
+        return it->second;
+    return LexerTokenType::VarToken;
+}
+
+template <LexerTokenType (*Classify)(std::string_view)>
+void classifyIdentifiers(benchmark::State& state)
+{
+    const auto words = makeIdentifiers(static_cast<size_t>(state.range(0)));
+    for (auto _ : state)
+    {
+        for (const auto& word : words)
+            benchmark::DoNotOptimize(Classify(word));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+LexerTokenType classifyWithPerfectHash(std::string_view word)
+{
+    return classifyKeyword(word);
+}
+} // namespace
+
+BENCHMARK(classifyIdentifiers<classifyWithMap>)->Name("Keywords/UnorderedMap")->Arg(4096);
+BENCHMARK(classifyIdentifiers<classifyWithPerfectHash>)->Name("Keywords/PerfectHash")->Arg(4096);
@@ -0,0 +1,37 @@
+#include "Lexer/Lexer.hpp"
+#include <benchmark/benchmark.h>
+#include <string>
+
+namespace
+{
+std::string makeSource(size_t bytes)
+{
+    std::string source;
+    for (size_t i = 0; source.size() < bytes; ++i)
+    {
+        const auto n = std::to_string(i);
+        source += "value" + n + " = (" + n + " + 3.5) * total # running sum\n";
+        source += "if (value" + n + " > 10) {\n    print(\"big\")\n} else {\n    print(value" + n + ")\n}\n";
+    }
+    return source;
+}
+
+void lexSequential(benchmark::State& state)
+{
+    const auto source = makeSource(static_cast<size_t>(state.range(0)));
+    for (auto _ : state)
+        benchmark::DoNotOptimize(Lexer(source).tokenizeAll());
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+
+void lexParallel(benchmark::State& state)
+{
+    const auto source = makeSource(static_cast<size_t>(state.range(0)));
+    for (auto _ : state)
+        benchmark::DoNotOptimize(Lexer(source).tokenizeAll(ThreadPool::shared()));
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+} // namespace
+
+BENCHMARK(lexSequential)->Name("Lexer/Sequential")->Arg(1 << 20)->Arg(16 << 20)->Unit(benchmark::kMillisecond);
+BENCHMARK(lexParallel)->Name("Lexer/Parallel")->Arg(1 << 20)->Arg(16 << 20)->Unit(benchmark::kMillisecond)->UseRealTime();
@@ -0,0 +1,254 @@
+#include "Compiler.hpp"
+#include "SyntheticSources.hpp"
+#include <benchmark/benchmark.h>
+#include <vector>
+
+namespace
+{
+SyntheticProgram programFor(const benchmark::State& state)
+{
+    return makeProgram(static_cast<Shape>(state.range(0)), static_cast<size_t>(state.range(1)));
+}
+
+// Parses every top-level statement the way Compiler::compile drives the parser
+std::vector<ASTNode*> parseAll(Parser& parser)
+{
+    std::vector<ASTNode*> nodes;
+    LexerToken                            token{"Program", noSourceOffset, LexerTokenType::ProgramToken};
+    parser.advanceToken(token);
+    while (token.type != LexerTokenType::Eof)
+    {
+        if (auto node = parser.parseStatement(token))
+            nodes.push_back(node);
+        if (!parser.expectNewlineOrEOF(token))
+            throw Error("Expected new line", token.offset);
+        parser.advancePastNewlines(token);
+    }
+    return nodes;
+}
+
+void analyzeAll(Semantic& semantic, ScopedSymbolTable& symbols, const std::vector<ASTNode*>& nodes)
+{
+    symbols.clear();
+    for (const auto& node : nodes)
+        semantic.analyzeTree(*node);
+}
+
+// Appends every statement to `ast` under a program block, as Compiler does, and returns the block
+FlatAST::NodeId flatten(FlatAST& ast, const std::vector<ASTNode*>& nodes)
+{
+    std::vector<FlatAST::NodeId> statements;
+    for (const auto& node : nodes)
+        statements.push_back(ast.append(*node));
+    return ast.addBlock({"Program", noSourceOffset, LexerTokenType::ProgramToken}, statements);
+}
+
+void lexerNextNWToken(benchmark::State& state)
+{
+    const auto program = programFor(state);
+    for (auto _ : state)
+    {
+        Lexer lexer(program.source);
+        for (auto token = lexer.nextNWToken(); token.type != LexerTokenType::Eof; token = lexer.nextNWToken())
+            benchmark::DoNotOptimize(token);
+    }
+    reportThroughput(state, program);
+}
+
+void lexerTokenizeAll(benchmark::State& state)
+{
+    const auto program = programFor(state);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(Lexer(program.source).tokenizeAll());
+    reportThroughput(state, program);
+}
+
+void parserParseStatement(benchmark::State& state)
+{
+    const auto     program = programFor(state);
+    CompilerOutput output;
+    Arena          arena;
+    for (auto _ : state)
+    {
+        // Reusing the arena's blocks keeps node allocation off the heap after the first iteration
+        arena.reset();
+        Parser parser(program.source, output, arena);
+        benchmark::DoNotOptimize(parseAll(parser));
+    }
+    reportThroughput(state, program);
+}
+
+void semanticAnalyzeTree(benchmark::State& state)
+{
+    const auto        program = programFor(state);
+    CompilerOutput    output;
+    Arena             arena;
+    Parser            parser(program.source, output, arena);
+    const auto        nodes = parseAll(parser);
+    ScopedSymbolTable symbols;
+    Semantic          semantic(output, symbols);
+    for (auto _ : state)
+        analyzeAll(semantic, symbols, nodes);
+    reportThroughput(state, program);
+}
+
+void codegenGenerate(benchmark::State& state)
+{
+    const auto        program = programFor(state);
+    CompilerOutput    output;
+    Arena             arena;
+    Parser            parser(program.source, output, arena);
+    const auto        nodes = parseAll(parser);
+    ScopedSymbolTable symbols;
+    Semantic          semantic(output, symbols);
+    analyzeAll(semantic, symbols, nodes);
+    for (auto _ : state)
+    {
+        WasmGen codegen(output, symbols);
+        for (const auto& node : nodes)
+            benchmark::DoNotOptimize(codegen.generate(*node));
+        benchmark::DoNotOptimize(codegen.getInstructions());
+    }
+    reportThroughput(state, program);
+}
+
+// Semantic analysis and code generation of every statement, in two walks per statement (fused:0) or in
+// one (fused:1, CompilerOptions::fuseCodegen)
+void analyzeAndGenerate(benchmark::State& state)
+{
+    const auto        program = programFor(state);
+    const bool        fused   = state.range(2) != 0;
+    CompilerOutput    output;
+    Arena             arena;
+    Parser            parser(program.source, output, arena);
+    const auto        nodes = parseAll(parser);
+    ScopedSymbolTable symbols;
+    Semantic          semantic(output, symbols);
+    for (auto _ : state)
+    {
+        symbols.clear();
+        WasmGen codegen(output, symbols);
+        for (const auto& node : nodes)
+        {
+            if (fused)
+                benchmark::DoNotOptimize(semantic.analyze(*node, codegen));
+            else
+            {
+                benchmark::DoNotOptimize(semantic.analyze(*node));
+                benchmark::DoNotOptimize(codegen.generate(*node));
+            }
+        }
+        benchmark::DoNotOptimize(codegen.getInstructions());
+    }
+    reportThroughput(state, program);
+}
+
+void compilerCollectOutputs(benchmark::State& state)
+{
+    const auto        program = programFor(state);
+    CompilerOutput    output;
+    Arena             arena;
+    Parser            parser(program.source, output, arena);
+    const auto        nodes = parseAll(parser);
+    ScopedSymbolTable symbols;
+    Semantic          semantic(output, symbols);
+    analyzeAll(semantic, symbols, nodes);
+    WasmGen codegen(output, symbols);
+    for (const auto& node : nodes)
+        codegen.generate(*node);
+    FlatAST    ast(parser.tokens());
+    const auto root = flatten(ast, nodes);
+
+    // Same collectors, in the same order, as Compiler::collectOutputs
+    for (auto _ : state)
+    {
+        output.getJson() = nlohmann::json::object();
+        parser.addTokensToOutput();
+        parser.addASTToOutput(ast, root);
+        semantic.addSymbolTableToOutput();
+        codegen.addGeneratedCodeToOutput();
+        benchmark::DoNotOptimize(output.getJson());
+    }
+    reportThroughput(state, program);
+}
+
+// The AST section as JSON text, which is what downstream tools had to parse before the binary format
+void astJson(benchmark::State& state)
+{
+    const auto     program = programFor(state);
+    CompilerOutput output;
+    Arena          arena;
+    Parser         parser(program.source, output, arena);
+    const auto     nodes = parseAll(parser);
+    FlatAST        ast(parser.tokens());
+    const auto     root = flatten(ast, nodes);
+    for (auto _ : state)
+    {
+        parser.addASTToOutput(ast, root);
+        benchmark::DoNotOptimize(output.getJson()["AST"].dump());
+    }
+    reportThroughput(state, program);
+}
+
+void astBinary(benchmark::State& state)
+{
+    const auto     program = programFor(state);
+    CompilerOutput output;
+    Arena          arena;
+    Parser         parser(program.source, output, arena);
+    const auto     nodes = parseAll(parser);
+    FlatAST        ast(parser.tokens());
+    const auto     root = flatten(ast, nodes);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(parser.binaryAST(ast, root));
+    reportThroughput(state, program);
+}
+
+void compileEndToEnd(benchmark::State& state, CompilerOptions options)
+{
+    const auto program = programFor(state);
+    for (auto _ : state)
+    {
+        CompilerOutput output;
+        if (!Compiler(program.source, output, options).compile())
+        {
+            state.SkipWithError(output.getJson().value("error", "compilation failed").c_str());
+            break;
+        }
+    }
+    reportThroughput(state, program);
+}
+
+void compilerEndToEnd(benchmark::State& state)
+{
+    compileEndToEnd(state, {});
+}
+
+// Parser, semantic analysis and code generation overlap, so this approaches the slowest of the three
+// given a core for each
+void compilerPipelined(benchmark::State& state)
+{
+    compileEndToEnd(state, {.pipelined = true});
+}
+
+void compilerFused(benchmark::State& state)
+{
+    compileEndToEnd(state, {.fuseCodegen = true});
+}
+} // namespace
+
+BENCHMARK(lexerNextNWToken)->Name("Lexer/NextNWToken")->Apply(syntheticInputs);
+BENCHMARK(lexerTokenizeAll)->Name("Lexer/TokenizeAll")->Apply(syntheticInputs);
+BENCHMARK(parserParseStatement)->Name("Parser/ParseStatement")->Apply(syntheticInputs);
+BENCHMARK(semanticAnalyzeTree)->Name("Semantic/AnalyzeTree")->Apply(syntheticInputs);
+BENCHMARK(codegenGenerate)->Name("Codegen/Generate")->Apply(syntheticInputs);
+BENCHMARK(analyzeAndGenerate)
+    ->Name("SemanticCodegen/AnalyzeAndGenerate")
+    ->ArgNames({"shape", "size", "fused"})
+    ->ArgsProduct({{0, 1, 3}, {4096}, {0, 1}});
+BENCHMARK(compilerCollectOutputs)->Name("Compiler/CollectOutputs")->Apply(syntheticInputs);
+BENCHMARK(astJson)->Name("AST/Json")->Apply(syntheticInputs);
+BENCHMARK(astBinary)->Name("AST/Binary")->Apply(syntheticInputs);
+BENCHMARK(compilerEndToEnd)->Name("Compiler/EndToEnd")->Apply(syntheticInputs);
+BENCHMARK(compilerFused)->Name("Compiler/Fused")->Apply(syntheticInputs);
+BENCHMARK(compilerPipelined)->Name("Compiler/Pipelined")->Apply(syntheticInputs)->UseRealTime();
@@ -0,0 +1,80 @@
+#include "Compiler.hpp"
+#include "SyntheticSources.hpp"
+#include <benchmark/benchmark.h>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////
+/// Generated code repeats the same pure sub-expressions many times. Each
+/// benchmark runs the same program with CompilerOptions::shareSubtrees
+/// off (share:0) and on (share:1). FrontEnd's arena_nodes counter is the
+/// number of nodes the parser allocated for the program.
+///////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+//! `size` assignments that each repeat `(ra + rb) * rc` four times
+SyntheticProgram makeRepeatedProgram(size_t size)
+{
+    SyntheticProgram program;
+    program.source = "ra = 3\nrb = 4\nrc = 5\n";
+    for (size_t i = 0; i < size; ++i)
+        program.source += "r" + std::to_string(i) +
+                          " = (ra + rb) * rc + (ra + rb) * rc * ((ra + rb) * rc - (ra + rb) * rc + 1)\n";
+    program.statements = size + 3;
+    return program;
+}
+
+void reportSharing(benchmark::State& state, const SyntheticProgram& program)
+{
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(program.source.size()));
+    state.counters["statements"] =
+        benchmark::Counter(static_cast<double>(state.iterations() * program.statements), benchmark::Counter::kIsRate);
+}
+
+// Parses, analyzes and flattens every statement, the front half of Compiler::compile
+void frontEnd(benchmark::State& state)
+{
+    const auto     program = makeRepeatedProgram(static_cast<size_t>(state.range(1)));
+    const bool     share   = state.range(0) != 0;
+    CompilerOutput output;
+    Arena          arena;
+    size_t         arenaNodes = 0;
+    for (auto _ : state)
+    {
+        arena.reset();
+        Parser            parser(program.source, output, arena, defaultMaxNestingDepth, nullptr, share);
+        ScopedSymbolTable symbols;
+        Semantic          semantic(output, symbols);
+        FlatAST           ast(parser.tokens(), share);
+        LexerToken        token{"Program", noSourceOffset, LexerTokenType::ProgramToken};
+        parser.advanceToken(token);
+        while (token.type != LexerTokenType::Eof)
+        {
+            auto node = parser.parseStatement(token);
+            semantic.analyzeTree(*node);
+            ast.append(*node);
+            parser.advancePastNewlines(token);
+        }
+        arenaNodes = arena.objectCount();
+    }
+    reportSharing(state, program);
+    state.counters["arena_nodes"] = static_cast<double>(arenaNodes);
+}
+
+void endToEnd(benchmark::State& state)
+{
+    const auto      program = makeRepeatedProgram(static_cast<size_t>(state.range(1)));
+    CompilerOptions options;
+    options.emitLexer     = false;
+    options.shareSubtrees = state.range(0) != 0;
+    for (auto _ : state)
+    {
+        CompilerOutput output;
+        benchmark::DoNotOptimize(Compiler(program.source, output, options).compile());
+    }
+    reportSharing(state, program);
+}
+} // namespace
+
+BENCHMARK(frontEnd)->Name("SharedSubtrees/FrontEnd")->ArgNames({"share", "size"})->ArgsProduct({{0, 1}, {256, 4096}});
+BENCHMARK(endToEnd)->Name("SharedSubtrees/EndToEnd")->ArgNames({"share", "size"})->ArgsProduct({{0, 1}, {256, 4096}});
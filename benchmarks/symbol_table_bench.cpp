@@ -0,0 +1,46 @@
+#include "Semantic/SymbolTable.hpp"
+#include <benchmark/benchmark.h>
+#include <string>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////
+/// Scope churn of deeply nested blocks, as generated `if` chains produce
+/// it: every level enters a scope, most declare nothing, and the
+/// innermost ones read variables declared at the top.
+///////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+void nestedScopes(benchmark::State& state)
+{
+    const auto            depth = static_cast<int>(state.range(0));
+    ScopedSymbolTable     symbols;
+    const LexerToken      token{"v", 0, LexerTokenType::VarToken};
+    std::vector<SymbolId> globals;
+    for (int i = 0; i < 16; ++i)
+    {
+        globals.push_back(symbols.identifiers().intern("g" + std::to_string(i)));
+        symbols.insert("g" + std::to_string(i), InferredType::INTEGER, token);
+    }
+    const SymbolId local = symbols.identifiers().intern("local");
+
+    for (auto _ : state)
+    {
+        for (int level = 0; level < depth; ++level)
+        {
+            symbols.enterScope();
+            // One level in eight declares a variable that shadows the one above it
+            if (level % 8 == 0)
+                benchmark::DoNotOptimize(symbols.tryInsert(local, InferredType::FLOAT, token));
+            for (auto global : globals)
+                benchmark::DoNotOptimize(symbols.lookup(global));
+        }
+        for (int level = 0; level < depth; ++level)
+            symbols.exitScope();
+    }
+    state.counters["lookups"] =
+        benchmark::Counter(static_cast<double>(state.iterations() * depth * globals.size()), benchmark::Counter::kIsRate);
+}
+} // namespace
+
+BENCHMARK(nestedScopes)->Name("SymbolTable/NestedScopes")->ArgName("depth")->Arg(16)->Arg(256)->Arg(4096);
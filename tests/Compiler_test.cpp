@@ -1,5 +1,14 @@
 #include "Compiler.hpp"
+#include "SourceFile.hpp"
+#include "SourceStream.hpp"
+#include <atomic>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <future>
 #include <gtest/gtest.h>
+#include <tuple>
 
 class CompilerIntegrationTest : public ::testing::Test
 {
@@ -29,3 +38,556 @@ TEST_F(CompilerIntegrationTest, ComplexExpression)
 result = 10 * (20 + 30) / 2
 )"));
 }
+
+TEST_F(CompilerIntegrationTest, CompilesFromSourceFile)
+{
+    const auto path = std::filesystem::temp_directory_path() / "curiousx_source_file_test.cx";
+    {
+        std::ofstream file(path, std::ios::binary);
+        file << "x = 42\ny = x * 2\nprint(y)\n";
+    }
+
+    {
+        SourceFile source(path.string());
+        EXPECT_EQ(source.view(), "x = 42\ny = x * 2\nprint(y)\n");
+        Compiler compiler(source.view(), output);
+        EXPECT_TRUE(compiler.compile());
+    }
+    std::filesystem::remove(path);
+}
+
+TEST_F(CompilerIntegrationTest, SourceFileHandlesEmptyAndMissingFiles)
+{
+    const auto path = std::filesystem::temp_directory_path() / "curiousx_empty_source_test.cx";
+    std::ofstream(path).close();
+    EXPECT_TRUE(SourceFile(path.string()).view().empty());
+    std::filesystem::remove(path);
+
+    EXPECT_THROW(SourceFile("/nonexistent/curiousx/input.cx"), std::runtime_error);
+}
+
+namespace
+{
+// Writes `source` into a temporary file and reopens it for reading as a plain descriptor
+int openAsStream(const std::filesystem::path& path, const std::string& source)
+{
+    std::ofstream(path, std::ios::binary) << source;
+    return ::open(path.c_str(), O_RDONLY);
+}
+} // namespace
+
+TEST_F(CompilerIntegrationTest, SourceStreamSplitsTopLevelStatements)
+{
+    const auto path = std::filesystem::temp_directory_path() / "curiousx_stream_split_test.cx";
+    const int  fd   = openAsStream(path, "a = 1\n\n# note\nif a > 0 {\n    print(a)\n}\nelse {\n    print(2)\n}\nb = \"{\"\n");
+    ASSERT_GE(fd, 0);
+
+    SourceStream stream(fd, 8);
+    auto         first = stream.nextStatement();
+    ASSERT_TRUE(first);
+    EXPECT_EQ(*first, "a = 1\n\n# note\n");
+    EXPECT_EQ(stream.firstLine(), 1u);
+
+    auto second = stream.nextStatement();
+    ASSERT_TRUE(second);
+    EXPECT_EQ(*second, "if a > 0 {\n    print(a)\n}\nelse {\n    print(2)\n}\n");
+    EXPECT_EQ(stream.firstLine(), 4u);
+
+    auto third = stream.nextStatement();
+    ASSERT_TRUE(third);
+    EXPECT_EQ(*third, "b = \"{\"\n");
+    EXPECT_EQ(stream.firstLine(), 10u);
+
+    EXPECT_FALSE(stream.nextStatement());
+    ::close(fd);
+    std::filesystem::remove(path);
+}
+
+TEST_F(CompilerIntegrationTest, SourceStreamMemoryIsBoundedByLargestStatement)
+{
+    std::string source;
+    for (int i = 0; i < 5000; ++i)
+        source += "v" + std::to_string(i) + " = " + std::to_string(i) + " * 2\n";
+
+    const auto path = std::filesystem::temp_directory_path() / "curiousx_stream_bound_test.cx";
+    const int  fd   = openAsStream(path, source);
+    ASSERT_GE(fd, 0);
+
+    SourceStream stream(fd, 256);
+    size_t       chunks = 0;
+    while (stream.nextStatement())
+        ++chunks;
+    EXPECT_EQ(chunks, 5000u);
+    EXPECT_EQ(stream.capacity(), 256u);
+    ::close(fd);
+    std::filesystem::remove(path);
+}
+
+TEST_F(CompilerIntegrationTest, StreamedCompileMatchesWholeFile)
+{
+    const std::string source = "s1 = 4\ns2 = 9\nif (s1 == s2) {\n    10 + s1\n} else {\n    print(s2 + 10)\n}\n\nif (s1 < s2) {\n    print(s1)\n}\nelse {\n    print(s2)\n}\nprint(s1 + 2)\n";
+
+    CompilerOutput whole;
+    ASSERT_TRUE(Compiler(source, whole).compile());
+
+    const auto path = std::filesystem::temp_directory_path() / "curiousx_stream_compile_test.cx";
+    const int  fd   = openAsStream(path, source);
+    ASSERT_GE(fd, 0);
+    SourceStream   stream(fd, 16);
+    CompilerOutput streamed;
+    EXPECT_TRUE(Compiler(streamed).compile(stream));
+    ::close(fd);
+    std::filesystem::remove(path);
+
+    EXPECT_EQ(streamed.getJson(), whole.getJson());
+}
+
+TEST_F(CompilerIntegrationTest, StreamedCompileWritesSectionsOnlyWhenAsked)
+{
+    // Errors end the Lexer section where they do for the whole source, and leave out the AST
+    const std::vector<std::string> sources = {
+        "s1 = 4\nprint(s1)\n",
+        "s1 = 4\ns2 = )\nif (s1 > 1) {\n    print(s1)\n}\ns3 = (\n",
+        "s1 = 4\nif (s1 > 1) {\n    s2 = s1 / 0\n}\nprint(s1)\n",
+        "s1 = 4\nif (s1 > 1) {\n    v = s1 * 2\n    print(v * 2)\n} else {\n    print(v * 2)\n}\nprint(s1 * 2)\n",
+    };
+    const auto path = std::filesystem::temp_directory_path() / "curiousx_stream_sections_test.cx";
+    for (const auto& source : sources)
+    {
+        for (const CompilerOptions& options : {CompilerOptions{},
+                                               CompilerOptions{.emitLexer = false},
+                                               CompilerOptions{.emitLexer = false, .emitAST = false},
+                                               CompilerOptions{.emitAST = false, .shareSubtrees = true}})
+        {
+            CompilerOutput whole;
+            const bool     compiled = Compiler(source, whole, options).compile();
+
+            const int fd = openAsStream(path, source);
+            ASSERT_GE(fd, 0);
+            SourceStream   stream(fd, 16);
+            CompilerOutput streamed;
+            EXPECT_EQ(Compiler(streamed, options).compile(stream), compiled);
+            ::close(fd);
+            EXPECT_EQ(streamed.getJson(), whole.getJson()) << source;
+        }
+    }
+    std::filesystem::remove(path);
+}
+
+TEST_F(CompilerIntegrationTest, StreamedCompileReportsSourceLines)
+{
+    const auto path = std::filesystem::temp_directory_path() / "curiousx_stream_error_test.cx";
+    const int  fd   = openAsStream(path, "e1 = 1\ne2 = 2\ne3 = $\n");
+    ASSERT_GE(fd, 0);
+    SourceStream   stream(fd);
+    CompilerOutput streamed;
+    EXPECT_FALSE(Compiler(streamed).compile(stream));
+    ::close(fd);
+    std::filesystem::remove(path);
+
+    EXPECT_NE(streamed.getJson()["error"].get<std::string>().find("line:3"), std::string::npos);
+}
+
+TEST_F(CompilerIntegrationTest, LexerSectionIsOptional)
+{
+    const std::string source = "l1 = 1\nprint(l1)\n";
+
+    CompilerOutput withLexer;
+    ASSERT_TRUE(Compiler(source, withLexer).compile());
+    const auto& tokens = withLexer.getJson()["Lexer"];
+    ASSERT_EQ(tokens.size(), 10u);
+    EXPECT_EQ(tokens[0]["value"], "l1");
+    EXPECT_EQ(tokens[0]["location"], "<line:1, col:1>");
+    EXPECT_EQ(tokens[9]["type"], "Eof");
+
+    CompilerOutput withoutLexer;
+    ASSERT_TRUE(Compiler(source, withoutLexer, {.emitLexer = false}).compile());
+    EXPECT_FALSE(withoutLexer.getJson().contains("Lexer"));
+    EXPECT_EQ(withoutLexer.getJson()["Gen"], withLexer.getJson()["Gen"]);
+}
+
+TEST_F(CompilerIntegrationTest, LexerSectionEndsAtTheFirstError)
+{
+    // Recovery goes on parsing, but the tokens it consumes after the first error are left out
+    CompilerOutput failed;
+    EXPECT_FALSE(Compiler("l2 = 1\nl3 = )\nl4 = 2\nl5 = (\n", failed).compile());
+    const auto& tokens = failed.getJson()["Lexer"];
+    ASSERT_EQ(tokens.size(), 7u);
+    EXPECT_EQ(tokens.back()["type"], "ParenClose");
+    EXPECT_EQ(tokens.back()["location"], "<line:2, col:6>");
+    EXPECT_EQ(failed.getJson()["errors"].size(), 2u);
+}
+
+TEST_F(CompilerIntegrationTest, ReportsEveryErrorAfterRecovering)
+{
+    CompilerOutput out;
+    EXPECT_FALSE(Compiler(R"(r1 = 1
+r2 = )
+if (r1 > 0) {
+    r3 = r1 +
+    r4 = "text" + 1
+    print(r1)
+}
+r5 = r1 / 0
+r6 = 2
+)",
+                          out)
+                     .compile());
+
+    const auto& errors = out.getJson()["errors"];
+    ASSERT_EQ(errors.size(), 4u);
+    EXPECT_EQ(errors[0]["location"], "<line:2, col:6>");
+    EXPECT_EQ(errors[1]["location"], "<line:4, col:14>");
+    EXPECT_EQ(errors[2]["message"], "Type mismatch in operation");
+    EXPECT_EQ(errors[3]["message"], "Division by zero");
+    EXPECT_NE(out.getJson()["error"].get<std::string>().find("line:2"), std::string::npos);
+    EXPECT_FALSE(out.getJson().contains("Gen"));
+}
+
+TEST_F(CompilerIntegrationTest, ErrorCountIsCapped)
+{
+    std::string source;
+    for (int i = 0; i < 100; ++i)
+        source += "capped = )\n";
+
+    CompilerOutput out;
+    EXPECT_FALSE(Compiler(source, out, {.maxErrors = 5}).compile());
+    EXPECT_EQ(out.getJson()["errors"].size(), 5u);
+
+    // A lexical error ends the token stream, so nothing after it is checked
+    CompilerOutput lexical;
+    EXPECT_FALSE(Compiler("lx = )\nly = @\nlz = )\n", lexical).compile());
+    ASSERT_EQ(lexical.getJson()["errors"].size(), 2u);
+    EXPECT_EQ(lexical.getJson()["errors"][1]["type"], getErrorTypeDescription(ErrorType::LEXICAL));
+}
+
+TEST_F(CompilerIntegrationTest, DeepInputIsAnErrorOrCompilesWithoutRecursion)
+{
+    // Nesting is limited by the parser, so overly deep input is reported rather than overflowing the stack
+    std::string ifs;
+    for (int i = 0; i < 100000; ++i)
+        ifs += "if (n > 1) {\n";
+    CompilerOutput nested;
+    EXPECT_FALSE(Compiler("n = 2\n" + ifs, nested).compile());
+    EXPECT_NE(nested.getJson()["error"].get<std::string>().find("Nesting is too deep"), std::string::npos);
+
+    CompilerOutput limited;
+    EXPECT_FALSE(Compiler("n = ((2))\n", limited, {.maxNestingDepth = 1}).compile());
+
+    // Operator chains are not nesting; every pass walks them without recursing
+    std::string chain = "chained = 1";
+    for (int i = 0; i < 20000; ++i)
+        chain += " + 1";
+    CompilerOutput flat;
+    EXPECT_TRUE(Compiler(chain + "\nprint(chained)\n", flat, {.emitLexer = false}).compile());
+    EXPECT_EQ(flat.dump().back(), '}');
+}
+
+TEST_F(CompilerIntegrationTest, DumpMatchesTheJsonLibrary)
+{
+    CompilerOutput out;
+    Compiler("d1 = 1.5\nif (d1 > 1.0) {\nprint(\"big\")\n} else {\nprint(d1 * 2.0)\n}\n", out).compile();
+    EXPECT_EQ(out.dump(), out.getJson().dump());
+    EXPECT_EQ(out.dump(4), out.getJson().dump(4));
+}
+
+TEST_F(CompilerIntegrationTest, PipelinedCompileMatchesSequential)
+{
+    std::string valid;
+    for (int i = 0; i < 16; ++i)
+    {
+        const auto n = std::to_string(i);
+        valid += "pv" + n + " = " + n + " * 2 + 1\npf" + n + " = 1.5 * " + n + ".0\n";
+        valid += "if (pv" + n + " > 10) {\n    pi" + n + " = 0.5\n    print(pi" + n + " * 2.0)\n} else {\n    print(\"low\")\n}\n";
+        valid += "print(pf" + n + " + 1.0)\nprint(pv" + n + " - 1)\n";
+    }
+
+    const std::vector<std::string> sources = {
+        valid,
+        valid + "pe1 = \"text\" + 1\npe2 = 2\n",
+        valid + "pe3 = )\npe4 = 1 / 0\n",
+        valid + "if (pv1 > 0) {\n    pe5 = pv1 +\n    print(pv1)\n}\npe6 = 3\n",
+        valid + "pe7 = 1 pe8 = 2\n",
+        valid + "pe9 = 1 + @\n",
+        "pe10 = 1 / 0\n" + valid,
+    };
+
+    auto run = [](const std::string& source, CompilerOptions options)
+    {
+        CompilerOutput out;
+        const bool     compiled = Compiler(source, out, options).compile();
+        return std::make_pair(compiled, out.dump());
+    };
+
+    ASSERT_TRUE(run(valid, {.pipelined = true}).first);
+    for (size_t maxErrors : {size_t{1}, defaultMaxErrors})
+    {
+        for (const auto& source : sources)
+        {
+            const auto sequential = run(source, {.maxErrors = maxErrors});
+            const auto pipelined  = run(source, {.maxErrors = maxErrors, .pipelined = true});
+            EXPECT_EQ(pipelined.first, sequential.first);
+            EXPECT_EQ(pipelined.second, sequential.second) << source.substr(valid.size());
+        }
+    }
+}
+
+TEST_F(CompilerIntegrationTest, BinaryASTMatchesTheASTSection)
+{
+    const std::string source = "ba = 2.5 * 4.0\nif (ba > 1.0) {\n    print(ba)\n} else {\n    print(\"small\")\n}\n";
+    Compiler compiler(source, output);
+    ASSERT_TRUE(compiler.compile());
+    const auto bytes = compiler.binaryAST();
+
+    auto reader = BinaryASTReader::open(bytes);
+    ASSERT_TRUE(reader.has_value()) << reader.error();
+
+    // Rebuilds the JSON form of each node from the binary one, the way Parser::addASTToOutput lays it out
+    const char* kinds[] = {"BinaryOperation", "ConditionalOperation", "BlockOperation"};
+    std::function<nlohmann::json(FlatAST::NodeId)> toJson = [&](FlatAST::NodeId id) -> nlohmann::json
+    {
+        if (id == FlatAST::none)
+            return nullptr;
+        nlohmann::json j = {{"type", kinds[static_cast<int>(reader->kind(id))]},
+                            {"token",
+                             {{"type", toString(reader->tokenType(id))},
+                              {"value", reader->value(id)},
+                              {"location", reader->location(id).toString()}}}};
+        const auto     slots = reader->children(id);
+        const std::vector<FlatAST::NodeId> kids(slots.begin(), slots.end());
+        switch (reader->kind(id))
+        {
+        case NodeType::BinaryOperation:
+            j["left"]  = toJson(kids[0]);
+            j["right"] = toJson(kids[1]);
+            break;
+        case NodeType::ConditionalOperation:
+            j["condition"] = toJson(kids[0]);
+            j["ifNode"]    = toJson(kids[1]);
+            if (kids[2] != FlatAST::none)
+                j["elseNode"] = toJson(kids[2]);
+            break;
+        case NodeType::BlockOperation:
+            j["children"] = nlohmann::json::array();
+            for (auto child : kids)
+                j["children"].push_back(toJson(child));
+            break;
+        }
+        return j;
+    };
+    EXPECT_EQ(toJson(reader->root()), output.getJson()["AST"]);
+    EXPECT_LT(bytes.size(), output.getJson()["AST"].dump().size() / 4);
+
+    // A failed compilation has no AST to encode
+    CompilerOutput failed;
+    Compiler       broken("bb = )\n", failed);
+    EXPECT_FALSE(broken.compile());
+    EXPECT_TRUE(broken.binaryAST().empty());
+
+    // A program without statements has nothing to compile but still encodes, as an empty Program block
+    CompilerOutput nothing;
+    Compiler       empty("", nothing);
+    EXPECT_FALSE(empty.compile());
+    const auto emptyBytes  = empty.binaryAST();
+    auto       emptyReader = BinaryASTReader::open(emptyBytes);
+    ASSERT_TRUE(emptyReader.has_value()) << emptyReader.error();
+    ASSERT_EQ(emptyReader->size(), 1u);
+    EXPECT_EQ(emptyReader->kind(emptyReader->root()), NodeType::BlockOperation);
+    EXPECT_EQ(emptyReader->tokenType(emptyReader->root()), LexerTokenType::ProgramToken);
+    EXPECT_EQ(emptyReader->children(emptyReader->root()).size(), 0u);
+
+    // Without the AST section the flat AST is only built when the binary form is asked for
+    CompilerOptions noAST;
+    noAST.emitAST = false;
+    CompilerOutput skipped;
+    Compiler       unkept(source, skipped, noAST);
+    ASSERT_TRUE(unkept.compile());
+    EXPECT_TRUE(unkept.binaryAST().empty());
+    EXPECT_FALSE(skipped.getJson().contains("AST"));
+
+    noAST.emitBinaryAST = true;
+    CompilerOutput binaryOnly;
+    Compiler       kept(source, binaryOnly, noAST);
+    ASSERT_TRUE(kept.compile());
+    EXPECT_EQ(kept.binaryAST(), bytes);
+    EXPECT_FALSE(binaryOnly.getJson().contains("AST"));
+}
+
+TEST_F(CompilerIntegrationTest, SharedSubtreesCompileTheSame)
+{
+    std::string source = "sa = 3\nsb = 4\n";
+    for (int i = 0; i < 8; ++i)
+        source += "sc = (sa * sb + 1) * (sa * sb + 1) - (sa * sb + 1)\nprint(sa * sb + sc)\nsa = sa + 1\n";
+    const std::vector<std::string> sources = {
+        source,
+        source + "if (sa > 1) {\n    sd = sa * sb\n    print(sd + sa * sb)\n}\nsd = \"text\"\nprint(sd + sd)\n",
+        source + "se = sa * sb + \"text\" * sb\nsf = 1 / 0 + 1 / 0\n",
+        "a = 1\nb = a * 2 + a * 2\nc = a * 2\n",
+        // The error is at the assignment, not at the read of the same variable before it
+        source + "if (sa > 1) {\n    print(sa)\n    sa = 1.5\n}\n",
+    };
+
+    auto run = [](const std::string& source, const CompilerOptions& options)
+    {
+        CompilerOutput out;
+        Compiler       compiler(source, out, options);
+        const bool     compiled = compiler.compile();
+        return std::make_tuple(compiled, out.getJson(), compiler.binaryAST());
+    };
+
+    for (const auto& source : sources)
+    {
+        CompilerOptions options;
+        auto [compiled, plain, plainAST] = run(source, options);
+        options.shareSubtrees            = true;
+        auto [sharedCompiled, shared, sharedAST] = run(source, options);
+        EXPECT_EQ(sharedCompiled, compiled);
+        EXPECT_EQ(shared["Gen"], plain["Gen"]);
+        EXPECT_EQ(shared["SymbolTable"], plain["SymbolTable"]);
+        EXPECT_EQ(shared["errors"], plain["errors"]);
+        EXPECT_EQ(shared["AST"], plain["AST"]);
+        EXPECT_EQ(sharedAST, plainAST);
+
+        // Without the AST, equal subtrees are one node
+        options.emitAST = false;
+        for (bool pipelined : {false, true})
+        {
+            options.pipelined                   = pipelined;
+            auto [nodesCompiled, nodes, unkept] = run(source, options);
+            EXPECT_EQ(nodesCompiled, compiled);
+            EXPECT_EQ(nodes["Gen"], plain["Gen"]);
+            EXPECT_EQ(nodes["SymbolTable"], plain["SymbolTable"]);
+            EXPECT_EQ(nodes["errors"], plain["errors"]) << source;
+        }
+    }
+}
+
+TEST_F(CompilerIntegrationTest, SharedSubtreesReportTheSameDiagnostics)
+{
+    // Each error is at an operand that occurs earlier in the same statement, in another context
+    const std::vector<std::string> sources = {
+        "if (1 < 2) {\n  x = 0\n  y = 5 / 0\n}\n",
+        "if (1 < 2) {\n  x = 0\n} else {\n  y = 3 / 0\n}\n",
+        "if (1 < 2) {\n  s = \"t\"\n  print(s)\n  w = 2 * s\n  print(1 + 2)\n  z = 1 + 2 / 0\n}\n",
+        "a = 1\nif (a > 0) {\n  b = a + 1\n  if (a + 1) {\n    print(b)\n  }\n}\n",
+        "if (1 < 2) {\n  v = 1\n  print(v * 2)\n} else {\n  print(v * 2)\n}\n",
+        // With an error the parser recovered from in the same statement
+        "if (1 < 2) {\n  v = 1\n  w = )\n  print(v * 2)\n} else {\n  print(v * 2)\n}\nu = 1 / 0\n",
+    };
+
+    auto run = [](const std::string& source, const CompilerOptions& options)
+    {
+        CompilerOutput out;
+        EXPECT_FALSE(Compiler(source, out, options).compile());
+        return out.getJson();
+    };
+
+    for (const auto& source : sources)
+    {
+        CompilerOptions options;
+        auto            plain = run(source, options);
+        options.shareSubtrees = true;
+        auto shared           = run(source, options);
+        EXPECT_FALSE(plain["errors"].empty());
+        EXPECT_EQ(shared["errors"], plain["errors"]) << source;
+        EXPECT_EQ(shared["AST"], plain["AST"]) << source;
+
+        // Shared nodes carry the first occurrence's token, yet errors are still where they occur
+        options.emitAST = false;
+        for (bool pipelined : {false, true})
+            for (bool fused : {false, true})
+            {
+                options.pipelined   = pipelined;
+                options.fuseCodegen = fused;
+                EXPECT_EQ(run(source, options)["errors"], plain["errors"]) << source;
+            }
+    }
+}
+
+TEST_F(CompilerIntegrationTest, FusedCodegenMatchesTwoWalks)
+{
+    std::string valid = "fa = 3\nfb = 1.5\nfs = \"text\"\n";
+    for (int i = 0; i < 4; ++i)
+    {
+        const auto n = std::to_string(i);
+        valid += "fc" + n + " = (fa * " + n + " + 1) * (fa * " + n + " + 1) - fa\nfd" + n + " = fb * 2.0 + fb\n";
+        valid += "if (fc" + n + " > fa) {\n    fe = fb / 0.5\n    print(fe * fe)\n    print(fs)\n} else {\n    print(\"low\")\n}\n";
+        valid += "print(fa)\nfa\n";
+    }
+
+    // Errors late in a statement, after code for part of it would have been emitted
+    const std::vector<std::string> sources = {
+        valid,
+        valid + "ff = fa * 2 + fb\nfg = fs\nprint(fg)\n",
+        valid + "if (fa > 1) {\n    fh = \"new\"\n    print(fh)\n    fa = 1.0\n}\nfi = 2\n",
+        valid + "print(fa + 1)\nprint(fb + 1)\nfj = 1 / 0\n",
+        "fk = 1\nfk = 1.5\n" + valid,
+    };
+
+    auto run = [](const std::string& source, CompilerOptions options)
+    {
+        CompilerOutput out;
+        const bool     compiled = Compiler(source, out, options).compile();
+        return std::make_pair(compiled, out.dump());
+    };
+
+    ASSERT_TRUE(run(valid, {.fuseCodegen = true}).first);
+    for (const auto& source : sources)
+    {
+        for (const auto& options : {CompilerOptions{.pipelined = true},
+                                    CompilerOptions{.shareSubtrees = true},
+                                    CompilerOptions{.maxErrors = 1}})
+        {
+            auto fusedOptions        = options;
+            fusedOptions.fuseCodegen = true;
+            const auto twoWalks      = run(source, options);
+            const auto fused         = run(source, fusedOptions);
+            EXPECT_EQ(fused.first, twoWalks.first);
+            EXPECT_EQ(fused.second, twoWalks.second) << source.substr(valid.size());
+        }
+    }
+}
+
+TEST_F(CompilerIntegrationTest, ConcurrentCompilesMatchSerialOnes)
+{
+    // Every program declares the same names, with types that differ between programs, so a shared
+    // symbol table would mix up scopes or reject redeclarations
+    std::vector<std::string> sources;
+    for (int i = 0; i < 8; ++i)
+    {
+        const auto n = std::to_string(i);
+        sources.push_back("x = " + n + "\ny = x * 2\nif (y > 4) {\n    z = y - x\n    print(z)\n}\nprint(x + y)\n");
+        sources.push_back("x = " + n + ".5\ny = x * 2.0\nif (y > 4.0) {\n    z = \"big\"\n    print(z)\n}\n");
+        sources.push_back("x = \"text\"\ny = x + " + n + "\nz = )\nprint(x)\n");
+    }
+
+    auto compile = [](const std::string& source)
+    {
+        CompilerOutput  out;
+        CompilerOptions options;
+        options.emitLexer = false;
+        Compiler(source, out, options).compile();
+        return out.dump();
+    };
+    std::vector<std::string> serial;
+    for (const auto& source : sources)
+        serial.push_back(compile(source));
+
+    // Hundreds of compiles on a small pool of threads, each taking the next job until none are left
+    constexpr size_t               jobs = 384;
+    std::vector<std::string>       results(jobs);
+    std::atomic<size_t>            next{0};
+    std::vector<std::future<void>> workers;
+    for (int t = 0; t < 8; ++t)
+        workers.push_back(std::async(std::launch::async,
+                                     [&]
+                                     {
+                                         for (size_t job = next++; job < jobs; job = next++)
+                                             results[job] = compile(sources[job % sources.size()]);
+                                     }));
+    for (auto& worker : workers)
+        worker.get();
+
+    for (size_t job = 0; job < jobs; ++job)
+        EXPECT_EQ(results[job], serial[job % sources.size()]) << sources[job % sources.size()];
+}
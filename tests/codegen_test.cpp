@@ -10,18 +10,21 @@
 class WasmGenTest : public ::testing::Test {
 protected:
     CompilerOutput output;
+    ScopedSymbolTable symbols;
+    Arena arena;
+    ASTNodeFactory factory{arena};
     std::unique_ptr<WasmGen> generator;
 
     void SetUp() override {
-        generator = std::make_unique<WasmGen>(output);  // Pass output to constructor
+        generator = std::make_unique<WasmGen>(output, symbols);  // Pass output to constructor
     }
 
     // Helper for creating leaf nodes
-    std::unique_ptr<BinaryNode> createLeafNode(std::string_view value, LexerTokenType type) {
-        return ASTNodeFactory::createBinaryNode(
+    BinaryNode* createLeafNode(std::string_view value, LexerTokenType type) {
+        return factory.createBinaryNode(
             nullptr,
             nullptr,
-            LexerToken{value, {0, 0}, type}
+            LexerToken{value, 0, type}
         );
     }
 
@@ -48,10 +51,10 @@ TEST_F(WasmGenTest, IntegerArithmetic) {
     // Create: 5 + 3
     auto left = createLeafNode("5", LexerTokenType::IntToken);
     auto right = createLeafNode("3", LexerTokenType::IntToken);
-    auto node = ASTNodeFactory::createBinaryNode(
-        std::move(left),
-        std::move(right),
-        LexerToken{"+", {0, 0}, LexerTokenType::PlusToken}
+    auto node = factory.createBinaryNode(
+        left,
+        right,
+        LexerToken{"+", 0, LexerTokenType::PlusToken}
     );
 
     generator->generate(*node);
@@ -68,10 +71,10 @@ TEST_F(WasmGenTest, IntegerArithmetic) {
 TEST_F(WasmGenTest, FloatArithmetic) {
     auto left = createLeafNode("5.0", LexerTokenType::FloatToken);
     auto right = createLeafNode("3.0", LexerTokenType::FloatToken);
-    auto node = ASTNodeFactory::createBinaryNode(
-        std::move(left),
-        std::move(right),
-        LexerToken{"*", {0, 0}, LexerTokenType::MultiplyToken}
+    auto node = factory.createBinaryNode(
+        left,
+        right,
+        LexerToken{"*", 0, LexerTokenType::MultiplyToken}
     );
 
     generator->generate(*node);
@@ -88,10 +91,10 @@ TEST_F(WasmGenTest, FloatArithmetic) {
 TEST_F(WasmGenTest, VariableAssignment) {
     auto left = createLeafNode("x", LexerTokenType::VarToken);
     auto right = createLeafNode("42", LexerTokenType::IntToken);
-    auto node = ASTNodeFactory::createBinaryNode(
-        std::move(left),
-        std::move(right),
-        LexerToken{"=", {0, 0}, LexerTokenType::AssignToken}
+    auto node = factory.createBinaryNode(
+        left,
+        right,
+        LexerToken{"=", 0, LexerTokenType::AssignToken}
     );
 
     generator->generate(*node);
@@ -106,27 +109,27 @@ TEST_F(WasmGenTest, VariableAssignment) {
 
 TEST_F(WasmGenTest, IfStatement) {
     // Create: if x > 5: print(x)
-    auto condition = ASTNodeFactory::createBinaryNode(
+    auto condition = factory.createBinaryNode(
         createLeafNode("x", LexerTokenType::VarToken),
         createLeafNode("5", LexerTokenType::IntToken),
-        LexerToken{">", {0, 0}, LexerTokenType::GreaterToken}
+        LexerToken{">", 0, LexerTokenType::GreaterToken}
     );
 
-    std::vector<std::unique_ptr<ASTNode>> thenChildren;
+    std::vector<ASTNode*> thenChildren;
     thenChildren.push_back(createLeafNode("x", LexerTokenType::VarToken));
-    auto thenBranch = ASTNodeFactory::createTreeNode(
-        std::move(thenChildren),
-        LexerToken{"print", {0, 0}, LexerTokenType::PrintToken}
+    auto thenBranch = factory.createTreeNode(
+        thenChildren,
+        LexerToken{"print", 0, LexerTokenType::PrintToken}
     );
 
-    auto ifNode = ASTNodeFactory::createConditionalNode(
-        std::move(condition),
-        std::move(thenBranch),
+    auto ifNode = factory.createConditionalNode(
+        condition,
+        thenBranch,
         nullptr,
-        LexerToken{"if", {0, 0}, LexerTokenType::IfToken}
+        LexerToken{"if", 0, LexerTokenType::IfToken}
     );
 
-    generator->generate(*ifNode);
+    ASSERT_TRUE(generator->generate(*ifNode));
     auto instructions = generator->getInstructions();
 
     std::vector<std::pair<WasmInstruction, std::string>> expected = {
@@ -140,3 +143,68 @@ TEST_F(WasmGenTest, IfStatement) {
     };
     verifyInstructions(instructions, expected);
 }
+
+TEST_F(WasmGenTest, LongChainsAreGeneratedIteratively) {
+    // 1 - 1 - ... - 1 nests to the left once per operator
+    ASTNode* chain = createLeafNode("1", LexerTokenType::IntToken);
+    for (int i = 0; i < 200000; ++i) {
+        chain = factory.createBinaryNode(
+            chain, createLeafNode("1", LexerTokenType::IntToken), LexerToken{"-", 0, LexerTokenType::MinusToken});
+    }
+
+    generator->generate(*chain);
+    auto instructions = generator->getInstructions();
+
+    ASSERT_EQ(instructions.size(), 400001u);
+    EXPECT_EQ(instructions[0].instruction, WasmInstruction::I32Const);
+    EXPECT_EQ(instructions[2].instruction, WasmInstruction::I32Sub);
+    EXPECT_EQ(instructions.back().instruction, WasmInstruction::I32Sub);
+}
+
+TEST_F(WasmGenTest, NestedOperationsUseTheAnnotatedType) {
+    // (a * b) + (a * b) over floats: the sum has no float leaf of its own
+    symbols.insert("a", InferredType::FLOAT, LexerToken{"a", 0, LexerTokenType::VarToken});
+    symbols.insert("b", InferredType::FLOAT, LexerToken{"b", 0, LexerTokenType::VarToken});
+    auto product = [this] {
+        return factory.createBinaryNode(createLeafNode("a", LexerTokenType::VarToken),
+                                        createLeafNode("b", LexerTokenType::VarToken),
+                                        LexerToken{"*", 0, LexerTokenType::MultiplyToken});
+    };
+    auto sum = factory.createBinaryNode(product(), product(), LexerToken{"+", 0, LexerTokenType::PlusToken});
+
+    Semantic semantic(output, symbols);
+    ASSERT_TRUE(semantic.analyze(*sum));
+    generator->generate(*sum);
+    auto instructions = generator->getInstructions();
+
+    ASSERT_EQ(instructions.size(), 7u);
+    EXPECT_EQ(instructions[2].instruction, WasmInstruction::F32Mul);
+    EXPECT_EQ(instructions[5].instruction, WasmInstruction::F32Mul);
+    EXPECT_EQ(instructions[6].instruction, WasmInstruction::F32Add);
+}
+
+TEST_F(WasmGenTest, RollbackForgetsCodeOfAFailedStatement) {
+    symbols.insert("y", InferredType::INTEGER, LexerToken{"y", 0, LexerTokenType::VarToken});
+    auto assign = [this](BinaryNode* value) {
+        return factory.createBinaryNode(
+            createLeafNode("z", LexerTokenType::VarToken), value, LexerToken{"=", 0, LexerTokenType::AssignToken});
+    };
+    Semantic semantic(output, symbols);
+
+    // z = y + "ab" fails on the string, after y was given a local and the string was emitted
+    const auto checkpoint = generator->checkpoint();
+    auto mismatch = factory.createBinaryNode(createLeafNode("y", LexerTokenType::VarToken),
+                                             createLeafNode("\"ab\"", LexerTokenType::StringToken),
+                                             LexerToken{"+", 0, LexerTokenType::PlusToken});
+    ASSERT_FALSE(semantic.analyze(*assign(mismatch), *generator));
+    EXPECT_FALSE(generator->getInstructions().empty());
+    generator->rollback(checkpoint);
+    EXPECT_TRUE(generator->getInstructions().empty());
+
+    ASSERT_TRUE(semantic.analyze(*assign(createLeafNode("\"cd\"", LexerTokenType::StringToken)), *generator));
+    verifyInstructions(generator->getInstructions(), {
+        {WasmInstruction::I32Const, "offset 0"},
+        {WasmInstruction::I32Const, "2"},
+        {WasmInstruction::LocalSet, "0"}
+    });
+}
@@ -0,0 +1,130 @@
+#include "Compiler.hpp"
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+class ConstantFolderTest : public ::testing::Test
+{
+  protected:
+    //! Instructions generated for `source` with constant folding
+    std::vector<std::string> fold(const std::string& source, CompilerOptions options = {})
+    {
+        CompilerOutput output;
+        options.emitLexer     = false;
+        options.foldConstants = true;
+        EXPECT_TRUE(Compiler(source, output, options).compile()) << output.dump();
+        return output.getJson()["Gen"][0].get<std::vector<std::string>>();
+    }
+};
+
+TEST_F(ConstantFolderTest, FoldsLiteralExpressions)
+{
+    EXPECT_EQ(fold("x = 2 * 3 + 4\n"), (std::vector<std::string>{"i32.const 10", "local.set 0"}));
+    EXPECT_EQ(fold("if (true != false) {\n    print(1)\n}\n")[0], "i32.const true");
+    // Operands that are not constant are emitted in their place, unchanged
+    EXPECT_EQ(fold("s = \"ab\"\nx = 007 + 1\ny = x * (2 + 3)\n", {.pipelined = true})[3], "i32.const 8");
+}
+
+TEST_F(ConstantFolderTest, IntegerArithmeticWrapsAround)
+{
+    EXPECT_EQ(fold("w = 2147483647 + 1\n")[0], "i32.const -2147483648");
+    EXPECT_EQ(fold("m = 65536 * 65536\n")[0], "i32.const 0");
+    EXPECT_EQ(fold("u = 4294967295 + 0\n")[0], "i32.const -1");
+    EXPECT_EQ(fold("q = (0 - 7) / 2\n")[0], "i32.const -3");
+    EXPECT_EQ(fold("if ((0 - 1) < 1) {\n    print(1)\n}\n")[0], "i32.const true");
+
+    // Division by zero and INT_MIN / -1 trap in wasm, so they are left to run
+    EXPECT_EQ(fold("z = 0\nd = 5 / z\n"),
+              (std::vector<std::string>{
+                  "i32.const 0", "local.set 0", "i32.const 5", "i32.const 0", "i32.div_s", "local.set 1"}));
+    EXPECT_EQ(fold("n = 0 - 2147483647 - 1\nr = n / (0 - 1)\n")[4], "i32.div_s");
+}
+
+TEST_F(ConstantFolderTest, FloatsRoundToSinglePrecision)
+{
+    // 16777217 is not a float, so the sum rounds back down
+    EXPECT_EQ(fold("f = 16777216.0 + 1.0\n")[0], "f32.const 16777216.0");
+    EXPECT_EQ(fold("g = 1.0 / 3.0\n")[0], "f32.const 0.33333334");
+    EXPECT_EQ(fold("if (0.1 + 0.2 == 0.3) {\n    print(1)\n}\n")[0], "i32.const true");
+    // An overflow to infinity is not written as a constant
+    EXPECT_EQ(fold("i = 300000000000000000000000000000000000000.0 * 10.0\n")[2], "f32.mul");
+}
+
+TEST_F(ConstantFolderTest, PropagatesThroughStraightLineCode)
+{
+    EXPECT_EQ(fold("a = 3\nb = a * 2\nprint(b + a)\n"),
+              (std::vector<std::string>{"i32.const 3",
+                                        "local.set 0",
+                                        "i32.const 6",
+                                        "local.set 1",
+                                        "i32.const 9",
+                                        "call $print"}));
+
+    // Each branch starts from the values before the conditional; after it, a variable either branch
+    // assigned is unknown
+    const auto code = fold("a = 3\nc = 0\nif (a > 2) {\n    a = 5\n    c = a + 1\n} else {\n    c = a\n}\n"
+                           "e = a + c\n");
+    EXPECT_EQ(code,
+              (std::vector<std::string>{"i32.const 3",
+                                        "local.set 0",
+                                        "i32.const 0",
+                                        "local.set 1",
+                                        "i32.const true",
+                                        "if",
+                                        "i32.const 5",
+                                        "local.set 0",
+                                        "i32.const 6",
+                                        "local.set 1",
+                                        "else",
+                                        "i32.const 3",
+                                        "local.set 1",
+                                        "end",
+                                        "local.get 0",
+                                        "local.get 1",
+                                        "i32.add",
+                                        "local.set 2"}));
+}
+
+TEST_F(ConstantFolderTest, ModesAgreeAndErrorsAreUnchanged)
+{
+    std::string valid = "a = 3\nf = 1.5\n";
+    for (int i = 0; i < 4; ++i)
+    {
+        const auto n = std::to_string(i);
+        valid += "b" + n + " = (a * " + n + " + 1) * (a * " + n + " + 1) - a\ng" + n + " = f * 2.0 + f\n";
+        valid += "if (b" + n + " > a) {\n    a = a + 1\n    print(a * 2)\n} else {\n    print(f)\n}\n";
+    }
+    const std::vector<std::string> sources = {
+        valid,
+        valid + "h = a * 2 + f\nk = 1 / 0\n",
+        valid + "if (a > 1) {\n    m = \"new\"\n    a = 1.0\n}\nn = a + 2\n",
+    };
+
+    auto run = [](const std::string& source, CompilerOptions options)
+    {
+        CompilerOutput out;
+        const bool     compiled = Compiler(source, out, options).compile();
+        return std::make_pair(compiled, out.getJson());
+    };
+
+    for (const auto& source : sources)
+    {
+        auto [compiled, plain] = run(source, {});
+        auto [foldedCompiled, folded] = run(source, {.foldConstants = true});
+        EXPECT_EQ(foldedCompiled, compiled);
+        EXPECT_EQ(folded["errors"], plain["errors"]);
+        if (compiled)
+        {
+            EXPECT_LT(folded["Gen"][0].size(), plain["Gen"][0].size());
+        }
+        for (const auto& options : {CompilerOptions{.pipelined = true, .foldConstants = true},
+                                    CompilerOptions{.shareSubtrees = true, .fuseCodegen = true, .foldConstants = true},
+                                    CompilerOptions{.pipelined = true, .fuseCodegen = true, .foldConstants = true}})
+        {
+            auto [otherCompiled, other] = run(source, options);
+            EXPECT_EQ(otherCompiled, foldedCompiled);
+            EXPECT_EQ(other["Gen"], folded["Gen"]);
+            EXPECT_EQ(other["errors"], folded["errors"]);
+        }
+    }
+}
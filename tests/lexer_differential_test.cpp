@@ -0,0 +1,401 @@
+#include "Lexer/Lexer.hpp"
+#include "Lexer/LineIndex.hpp"
+#include <algorithm>
+#include <gtest/gtest.h>
+#include <optional>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Character-at-a-time lexer the table-driven scanner replaced; kept here as the oracle.
+// It tracks line/column eagerly, which the offset-based tokens resolve through LineIndex.
+namespace reference
+{
+struct Token
+{
+    std::string_view value;
+    SourceLocation   location;
+    LexerTokenType   type;
+};
+
+struct LexicalError
+{
+    std::string    message;
+    SourceLocation location;
+};
+
+class Lexer
+{
+  public:
+    explicit Lexer(std::string_view data) : data(data) {}
+
+    Token nextToken()
+    {
+        const SourceLocation location = SourceLocation(y_pos, x_pos);
+        const auto           startPos = pos;
+        const char           nchar    = next_char();
+
+        static const std::unordered_map<char, std::pair<std::string_view, LexerTokenType>> singleCharTokens = {
+            {'\0', {"\0", LexerTokenType::Eof}},
+            {'\n', {"\\n", LexerTokenType::Newline}},
+            {'\t', {"\t", LexerTokenType::Tab}},
+            {'(', {"(", LexerTokenType::ParenOpen}},
+            {')', {")", LexerTokenType::ParenClose}},
+            {'{', {"{", LexerTokenType::BracesOpen}},
+            {'}', {"}", LexerTokenType::BracesClose}},
+            {'+', {"+", LexerTokenType::PlusToken}},
+            {'/', {"/", LexerTokenType::DivideToken}},
+            {'*', {"*", LexerTokenType::MultiplyToken}},
+            {'-', {"-", LexerTokenType::MinusToken}}};
+
+        if (auto it = singleCharTokens.find(nchar); it != singleCharTokens.end())
+            return {it->second.first, location, it->second.second};
+
+        if (nchar == ' ')
+        {
+            while (peek_next_char() == ' ')
+                next_char();
+            return {data.substr(startPos, pos - startPos), location, LexerTokenType::Space};
+        }
+        if (nchar == '#')
+        {
+            while (peek_next_char() != '\n' && peek_next_char() != '\0')
+                next_char();
+            return {data.substr(startPos, pos - startPos), location, LexerTokenType::CommentToken};
+        }
+        if (nchar == '!')
+        {
+            if (next_char() == '=')
+                return {data.substr(startPos, 2), location, LexerTokenType::NotEqualToken};
+            throw LexicalError{"Lexical Error- Unexpected character after '!' ", location};
+        }
+        for (auto [c, single, twoChar] : {std::tuple{'>', LexerTokenType::GreaterToken, LexerTokenType::GreaterEqualToken},
+                                          std::tuple{'<', LexerTokenType::LessToken, LexerTokenType::LessEqualToken},
+                                          std::tuple{'=', LexerTokenType::AssignToken, LexerTokenType::EqualToken}})
+        {
+            if (nchar != c)
+                continue;
+            if (peek_next_char() == '=')
+            {
+                next_char();
+                return {data.substr(startPos, 2), location, twoChar};
+            }
+            return {data.substr(startPos, 1), location, single};
+        }
+        if (nchar == '"')
+        {
+            size_t count = 1;
+            auto   t     = next_char();
+            while (t != '"')
+            {
+                if (t == '\0' || t == '\n')
+                    throw LexicalError{"Unclosed string literal", location};
+                count++;
+                t = next_char();
+            }
+            return {data.substr(startPos, count + 1), location, LexerTokenType::StringToken};
+        }
+        if (!(std::isalpha(static_cast<unsigned char>(nchar)) || std::isdigit(static_cast<unsigned char>(nchar))))
+            throw LexicalError{" Lexical Error- Unknown character", location};
+
+        while (std::isalnum(static_cast<unsigned char>(peek_next_char())) || peek_next_char() == '.')
+            next_char();
+        auto substr = data.substr(startPos, pos - startPos);
+        if (std::all_of(substr.begin(), substr.end(), [](char c) { return std::isdigit(c) || c == '.'; }))
+            return {substr,
+                    location,
+                    substr.find('.') == std::string::npos ? LexerTokenType::IntToken : LexerTokenType::FloatToken};
+
+        static const std::unordered_map<std::string_view, LexerTokenType> keywords = {
+            {"print", LexerTokenType::PrintToken},
+            {"Print", LexerTokenType::PrintToken},
+            {"if", LexerTokenType::IfToken},
+            {"else", LexerTokenType::ElseToken},
+            {"true", LexerTokenType::BoolToken},
+            {"false", LexerTokenType::BoolToken}};
+        if (auto it = keywords.find(substr); it != keywords.end())
+            return {substr, location, it->second};
+        return {substr, location, LexerTokenType::VarToken};
+    }
+
+  private:
+    std::string_view data;
+    size_t           pos   = 0;
+    unsigned short   x_pos = 1;
+    unsigned short   y_pos = 1;
+
+    char next_char()
+    {
+        if (pos >= data.size())
+            return '\0';
+        char c = data[pos++];
+        if (c == '\n')
+        {
+            y_pos++;
+            x_pos = 1;
+        }
+        else
+        {
+            x_pos++;
+        }
+        return c;
+    }
+
+    char peek_next_char() const { return pos < data.size() ? data[pos] : '\0'; }
+};
+} // namespace reference
+
+namespace
+{
+struct LexResult
+{
+    std::vector<reference::Token> tokens;
+    std::optional<std::string>    error;
+};
+
+std::string describe(std::string_view message, const SourceLocation& location)
+{
+    return location.toString() + ": " + std::string(message);
+}
+
+LexResult lexReference(std::string_view input)
+{
+    reference::Lexer lexer(input);
+    LexResult        result;
+    try
+    {
+        for (auto token = lexer.nextToken(); token.type != LexerTokenType::Eof; token = lexer.nextToken())
+            result.tokens.push_back(token);
+    }
+    catch (const reference::LexicalError& e)
+    {
+        result.error = describe(e.message, e.location);
+    }
+    return result;
+}
+
+LexResult lexActual(std::string_view input)
+{
+    Lexer     lexer(input);
+    LineIndex lines(input);
+    LexResult result;
+    try
+    {
+        for (auto token = lexer.nextToken(); token.type != LexerTokenType::Eof; token = lexer.nextToken())
+            result.tokens.push_back({token.value, lines.locate(token.offset), token.type});
+    }
+    catch (const Error& e)
+    {
+        EXPECT_EQ(e.getType(), ErrorType::LEXICAL);
+        result.error = describe(e.getMessage(), lines.locate(e.getOffset()));
+    }
+    return result;
+}
+
+void expectSameStream(std::string_view input)
+{
+    auto expected = lexReference(input);
+    auto actual   = lexActual(input);
+
+    ASSERT_EQ(actual.tokens.size(), expected.tokens.size()) << "input: " << input;
+    for (size_t i = 0; i < actual.tokens.size(); ++i)
+    {
+        EXPECT_EQ(actual.tokens[i].type, expected.tokens[i].type) << "token " << i << " of: " << input;
+        EXPECT_EQ(actual.tokens[i].value, expected.tokens[i].value) << "token " << i << " of: " << input;
+        EXPECT_EQ(actual.tokens[i].location.toString(), expected.tokens[i].location.toString())
+            << "token " << i << " of: " << input;
+    }
+    EXPECT_EQ(actual.error, expected.error) << "input: " << input;
+}
+
+std::string randomSource(std::mt19937& rng, size_t length)
+{
+    static constexpr std::string_view fragments[] = {
+        " ",   "    ",  "\t",    "\n",      "x",     "alpha1", "3",        "42",   "3.14", "1.2.3", "if",
+        "else", "print", "Print", "true",   "false", "(",      ")",        "{",    "}",    "+",     "-",
+        "*",   "/",     "=",     "==",      "!=",    "<",      "<=",       ">",    ">=",   "#note", "\"str\"",
+        ".",   "a.b",   "_",     "\"open",  "!x",    "\xc3\xa9", "longidentifier_with_underscore"};
+    std::uniform_int_distribution<size_t> pick(0, std::size(fragments) - 1);
+
+    std::string source;
+    while (source.size() < length)
+        source += fragments[pick(rng)];
+    return source;
+}
+} // namespace
+
+TEST(LexerDifferentialTest, HandWrittenCorpus)
+{
+    const std::vector<std::string> corpus = {
+        "",
+        "a = 7\nb = 9\nx = \"hello\" #this is a comment \nif (a == b) {\n    10 + a\n} else {\n    print(b + 10)\n}",
+        "result = 10 * (20 + 30) / 2",
+        "x    =     1\t\t2",
+        std::string(100, ' ') + "tail",
+        std::string(70, 'a') + " " + std::string(33, '7') + "." + std::string(40, '1'),
+        "# " + std::string(200, 'c') + "\nnext",
+        "#" + std::string(31, 'c') + std::string(1, '\0') + "after",
+        "x = 1" + std::string(1, '\0') + "y = 2",
+        "\"unterminated\nstring\"",
+        "\"unterminated",
+        "a != b !c",
+        "<=>=<>==!=",
+        "x = 5 @ 3",
+        "v\xff",
+    };
+    for (const auto& input : corpus)
+        expectSameStream(input);
+}
+
+TEST(LexerDifferentialTest, RandomSources)
+{
+    std::mt19937 rng(20240517);
+    for (int i = 0; i < 500; ++i)
+        expectSameStream(randomSource(rng, 1 + static_cast<size_t>(i) * 3));
+}
+
+TEST(LexerDifferentialTest, TokenizeAllMatchesTokenStream)
+{
+    std::mt19937 rng(1234);
+    for (int i = 0; i < 200; ++i)
+    {
+        const auto input    = randomSource(rng, 1 + static_cast<size_t>(i) * 5);
+        auto       expected = lexReference(input);
+        std::erase_if(expected.tokens, [](const reference::Token& t)
+                      { return t.type == LexerTokenType::Space || t.type == LexerTokenType::Tab; });
+
+        const auto buffer = Lexer(input).tokenizeAll();
+        LineIndex  lines(input);
+        ASSERT_EQ(buffer.size(), expected.tokens.size() + 1) << "input: " << input;
+        for (size_t t = 0; t < expected.tokens.size(); ++t)
+        {
+            const auto token = buffer.token(t);
+            EXPECT_EQ(token.type, expected.tokens[t].type) << "token " << t << " of: " << input;
+            EXPECT_EQ(token.value, expected.tokens[t].value) << "token " << t << " of: " << input;
+            EXPECT_EQ(lines.locate(token.offset).toString(), expected.tokens[t].location.toString());
+        }
+
+        const auto last = buffer.size() - 1;
+        if (expected.error)
+        {
+            EXPECT_EQ(buffer.type(last), LexerTokenType::Unknown);
+            ASSERT_TRUE(buffer.error().has_value());
+            EXPECT_EQ(describe(buffer.error()->getMessage(), lines.locate(buffer.error()->getOffset())),
+                      *expected.error);
+        }
+        else
+        {
+            EXPECT_EQ(buffer.type(last), LexerTokenType::Eof);
+        }
+    }
+}
+
+TEST(LexerDifferentialTest, ParallelTokenizeMatchesSequential)
+{
+    ThreadPool   pool(4);
+    std::mt19937 rng(99);
+    for (int i = 0; i < 300; ++i)
+    {
+        auto input = randomSource(rng, 1 + static_cast<size_t>(i) * 17);
+        if (i % 7 == 3)
+            input[input.size() / 2] = '\0';
+
+        const auto expected = Lexer(input).tokenizeAll();
+        const auto actual   = Lexer(input).tokenizeAll(pool, 16);
+        ASSERT_EQ(actual.size(), expected.size()) << "input: " << input;
+        for (size_t t = 0; t < expected.size(); ++t)
+        {
+            EXPECT_EQ(actual.type(t), expected.type(t)) << "token " << t << " of: " << input;
+            EXPECT_EQ(actual.offset(t), expected.offset(t)) << "token " << t << " of: " << input;
+            EXPECT_EQ(actual.value(t), expected.value(t)) << "token " << t << " of: " << input;
+        }
+        ASSERT_EQ(actual.error().has_value(), expected.error().has_value()) << "input: " << input;
+        if (expected.error())
+        {
+            EXPECT_EQ(actual.error()->getMessage(), expected.error()->getMessage());
+            EXPECT_EQ(actual.error()->getOffset(), expected.error()->getOffset());
+        }
+    }
+}
+
+TEST(LexerDifferentialTest, ParallelTokenizeInsideAPoolTaskRunsInline)
+{
+    // With one worker, waiting there for chunks queued behind the running task would never return
+    ThreadPool   pool(1);
+    std::mt19937 rng(7);
+    const auto   input    = randomSource(rng, 4096);
+    const auto   expected = Lexer(input).tokenizeAll();
+    const auto   actual   = pool.submit([&] { return Lexer(input).tokenizeAll(pool, 16); }).get();
+    ASSERT_EQ(actual.size(), expected.size());
+    for (size_t t = 0; t < expected.size(); ++t)
+        EXPECT_EQ(actual.offset(t), expected.offset(t)) << "token " << t;
+    EXPECT_FALSE(pool.onWorkerThread());
+}
+
+TEST(LexerDifferentialTest, RelexMatchesFullLex)
+{
+    std::mt19937 rng(4242);
+    for (int i = 0; i < 1000; ++i)
+    {
+        const auto before = randomSource(rng, 1 + static_cast<size_t>(i % 200) * 3);
+        const auto after  = randomSource(rng, static_cast<size_t>(i % 5));
+
+        std::uniform_int_distribution<size_t> at(0, before.size());
+        const size_t                          offset = at(rng);
+        std::uniform_int_distribution<size_t> span(0, std::min<size_t>(before.size() - offset, 12));
+        const size_t                          removed  = span(rng);
+        std::string                           inserted = after.substr(0, std::min<size_t>(after.size(), i % 9));
+        if (i % 13 == 0)
+            inserted += '\0';
+
+        std::string edited = before;
+        edited.replace(offset, removed, inserted);
+
+        auto tokens = Lexer(before).tokenizeAll();
+        Lexer::relex(tokens,
+                     edited,
+                     {static_cast<std::uint32_t>(offset), static_cast<std::uint32_t>(removed), inserted});
+        const auto expected = Lexer(edited).tokenizeAll();
+
+        ASSERT_EQ(tokens.size(), expected.size()) << "edit at " << offset << " of: " << before;
+        for (size_t t = 0; t < expected.size(); ++t)
+        {
+            EXPECT_EQ(tokens.type(t), expected.type(t)) << "token " << t << " of: " << edited;
+            EXPECT_EQ(tokens.offset(t), expected.offset(t)) << "token " << t << " of: " << edited;
+            EXPECT_EQ(tokens.value(t), expected.value(t)) << "token " << t << " of: " << edited;
+        }
+        ASSERT_EQ(tokens.error().has_value(), expected.error().has_value()) << "edited: " << edited;
+        if (expected.error())
+        {
+            EXPECT_EQ(tokens.error()->getMessage(), expected.error()->getMessage());
+            EXPECT_EQ(tokens.error()->getOffset(), expected.error()->getOffset());
+        }
+    }
+}
+
+TEST(LexerDifferentialTest, KernelsMatchScalarAtEveryAlignment)
+{
+    std::mt19937                       rng(7);
+    std::uniform_int_distribution<int> byte(0, 255);
+    const std::string                  alphabet = " aZ9._\n\t#\"";
+    std::uniform_int_distribution<size_t> pick(0, alphabet.size() - 1);
+
+    for (int round = 0; round < 200; ++round)
+    {
+        std::string buffer(97, ' ');
+        for (auto& c : buffer)
+            c = round % 2 ? alphabet[pick(rng)] : static_cast<char>(byte(rng));
+        // Long homogeneous runs exercise the full-width vector steps
+        std::fill_n(buffer.begin() + round % 20, round % 50, round % 3 ? 'q' : ' ');
+
+        const char* end = buffer.data() + buffer.size();
+        for (size_t offset = 0; offset <= buffer.size(); ++offset)
+        {
+            const char* p = buffer.data() + offset;
+            EXPECT_EQ(scan::skipSpaces(p, end), scan::skipSpacesScalar(p, end));
+            EXPECT_EQ(scan::skipIdentifier(p, end), scan::skipIdentifierScalar(p, end));
+            EXPECT_EQ(scan::skipLineBody(p, end), scan::skipLineBodyScalar(p, end));
+        }
+    }
+}
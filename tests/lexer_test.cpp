@@ -1,4 +1,5 @@
 #include "Lexer/Lexer.hpp"
+#include "Lexer/LineIndex.hpp"
 #include "Parser/Parser.hpp"
 #include <gtest/gtest.h>
 
@@ -100,3 +101,119 @@ y = x + 10
 
     verifyTokenSequence(tokens, expected);
 }
+
+TEST_F(LexerTest, TokenizeAllDropsWhitespace)
+{
+    std::string_view source = "x  =\t42\n\"s\"";
+    auto             buffer = Lexer(source).tokenizeAll();
+
+    std::vector<std::pair<LexerTokenType, std::string>> expected = {
+        {LexerTokenType::VarToken, "x"},
+        {LexerTokenType::AssignToken, "="},
+        {LexerTokenType::IntToken, "42"},
+        {LexerTokenType::Newline, "\\n"},
+        {LexerTokenType::StringToken, "\"s\""},
+        {LexerTokenType::Eof, ""},
+    };
+
+    ASSERT_EQ(buffer.size(), expected.size());
+    for (size_t i = 0; i < buffer.size(); ++i)
+    {
+        expectToken(buffer.token(i), expected[i].first, expected[i].second);
+    }
+    EXPECT_EQ(buffer.offset(2), 5u);
+    EXPECT_EQ(buffer.length(2), 2u);
+    EXPECT_EQ(buffer.offset(4), 8u);
+    EXPECT_FALSE(buffer.error().has_value());
+}
+
+TEST_F(LexerTest, TokenizeAllStopsAtLexicalError)
+{
+    auto buffer = Lexer("x = 1\ny = @").tokenizeAll();
+
+    ASSERT_EQ(buffer.size(), 7u);
+    EXPECT_EQ(buffer.type(6), LexerTokenType::Unknown);
+    EXPECT_EQ(buffer.offset(6), 10u);
+    ASSERT_TRUE(buffer.error().has_value());
+    EXPECT_EQ(buffer.error()->getType(), ErrorType::LEXICAL);
+}
+
+TEST_F(LexerTest, TryNextTokenReturnsLexicalErrors)
+{
+    Lexer lexer("x = @");
+    for (int i = 0; i < 2; ++i)
+        ASSERT_TRUE(lexer.tryNextNWToken().has_value());
+
+    auto token = lexer.tryNextNWToken();
+    ASSERT_FALSE(token.has_value());
+    EXPECT_EQ(token.error().getType(), ErrorType::LEXICAL);
+    EXPECT_EQ(token.error().getOffset(), 4u);
+}
+
+TEST_F(LexerTest, LineIndexResolvesOffsets)
+{
+    std::string_view source = "a = 1\n\nbb = 22\n";
+    LineIndex        lines(source);
+
+    EXPECT_EQ(lines.locate(0).toString(), "<line:1, col:1>");
+    EXPECT_EQ(lines.locate(4).toString(), "<line:1, col:5>");
+    EXPECT_EQ(lines.locate(5).toString(), "<line:1, col:6>");
+    EXPECT_EQ(lines.locate(6).toString(), "<line:2, col:1>");
+    EXPECT_EQ(lines.locate(12).toString(), "<line:3, col:6>");
+    EXPECT_EQ(lines.locate(static_cast<std::uint32_t>(source.size())).toString(), "<line:4, col:1>");
+    EXPECT_EQ(lines.locate(noSourceOffset).toString(), "<line:0, col:0>");
+}
+
+TEST_F(LexerTest, LineIndexBeyondSixteenBitLines)
+{
+    std::string source;
+    for (int i = 0; i < 70000; ++i)
+        source += "x = 1\n";
+    source += "y = @";
+
+    auto buffer = Lexer(source).tokenizeAll();
+    ASSERT_TRUE(buffer.error().has_value());
+
+    LineIndex lines(source);
+    EXPECT_EQ(lines.locate(buffer.error()->getOffset()).toString(), "<line:70001, col:5>");
+}
+
+TEST_F(LexerTest, KeywordPerfectHash)
+{
+    for (const auto& keyword : keywordList)
+    {
+        EXPECT_EQ(classifyKeyword(keyword.spelling), keyword.type) << keyword.spelling;
+    }
+    for (std::string_view word : {"x", "prin", "printt", "PRINT", "iff", "elsE", "True", "fals", "e1se", "t"})
+    {
+        EXPECT_EQ(classifyKeyword(word), LexerTokenType::VarToken) << word;
+    }
+}
+
+TEST_F(LexerTest, InternedIdentifiersAreDense)
+{
+    IdentifierTable identifiers;
+    auto            buffer = Lexer("beta = alpha + 1\nalpha = beta * beta\nprint(\"beta\")\n").tokenizeAll();
+    EXPECT_EQ(buffer.token(0).symbol, noSymbol); // not interned yet
+
+    buffer.intern(identifiers);
+    ASSERT_EQ(identifiers.size(), 2u);
+    EXPECT_EQ(identifiers.name(0), "beta");
+    EXPECT_EQ(identifiers.name(1), "alpha");
+    for (size_t i = 0; i < buffer.size(); ++i)
+    {
+        const auto token = buffer.token(i);
+        if (token.type == LexerTokenType::VarToken)
+            EXPECT_EQ(token.symbol, *identifiers.find(token.value)) << i;
+        else
+            EXPECT_EQ(token.symbol, noSymbol) << i;
+    }
+
+    // Another source keeps the IDs of the names it shares with the first
+    auto more = Lexer("gamma = alpha").tokenizeAll();
+    more.intern(identifiers);
+    EXPECT_EQ(more.token(0).symbol, 2u);
+    EXPECT_EQ(more.token(2).symbol, 1u);
+    EXPECT_EQ(identifiers.idOf(LexerToken{"beta", 0, LexerTokenType::VarToken}), 0u);
+    EXPECT_FALSE(identifiers.find("delta").has_value());
+}
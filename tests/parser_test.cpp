@@ -5,8 +5,12 @@
 class ParserTest : public ::testing::Test
 {
   protected:
-    std::unique_ptr<Parser> createParser(std::string_view input) { return std::make_unique<Parser>(input, output); }
-    CompilerOutput          output;
+    std::unique_ptr<Parser> createParser(std::string_view input)
+    {
+        return std::make_unique<Parser>(input, output, arena);
+    }
+    CompilerOutput output;
+    Arena          arena;
 };
 
 // Binary Operations Tests
@@ -106,4 +110,345 @@ TEST_F(ParserTest, InvalidBinaryOperation)
     LexerToken token;
     parser->advanceToken(token);
     EXPECT_THROW(parser->parseStatement(token), Error);
+}
+TEST_F(ParserTest, ArenaIsReusedAfterReset)
+{
+    const std::string source = "a = 1 + 2 * 3\nif (a > 2) {\n    print(a)\n} else {\n    print(a + 1)\n}\n";
+    Arena             local(256);
+
+    auto parseAll = [&]
+    {
+        Parser     parser(source, output, local);
+        LexerToken token;
+        parser.advanceToken(token);
+        while (token.type != LexerTokenType::Eof)
+        {
+            ASSERT_NE(parser.parseStatement(token), nullptr);
+            parser.advancePastNewlines(token);
+        }
+    };
+
+    parseAll();
+    const auto blocks = local.blockCount();
+    EXPECT_GT(blocks, 1u);
+    for (int i = 0; i < 10; ++i)
+    {
+        local.reset();
+        parseAll();
+    }
+    EXPECT_EQ(local.blockCount(), blocks);
+}
+
+TEST_F(ParserTest, FlatASTStoresChildrenBeforeParents)
+{
+    auto       parser = createParser("total = 1 + 2\n");
+    LexerToken token;
+    parser->advanceToken(token);
+    auto node = parser->parseStatement(token);
+
+    FlatAST    ast(parser->tokens());
+    const auto root = ast.append(*node);
+    ASSERT_EQ(ast.size(), 5u);
+    EXPECT_EQ(root, 4u);
+    for (FlatAST::NodeId id = 0; id < ast.size(); ++id)
+    {
+        for (auto child : ast.children(id))
+        {
+            if (child != FlatAST::none)
+            {
+                EXPECT_LT(child, id);
+            }
+        }
+    }
+
+    EXPECT_EQ(ast.kind(root), NodeType::BinaryOperation);
+    EXPECT_EQ(ast.token(root).value, "=");
+    const auto sides = ast.children(root);
+    ASSERT_EQ(sides.size(), 2u);
+    EXPECT_EQ(ast.token(sides[0]).value, "total");
+    EXPECT_EQ(ast.token(sides[1]).type, LexerTokenType::PlusToken);
+    EXPECT_EQ(ast.children(ast.children(sides[1])[0])[0], FlatAST::none);
+
+    const auto program = ast.addBlock({"Program", noSourceOffset, LexerTokenType::ProgramToken}, std::span(&root, 1));
+    EXPECT_EQ(ast.token(program).value, "Program");
+    EXPECT_EQ(ast.children(program)[0], root);
+}
+
+TEST_F(ParserTest, PrintTermsBindTighterThanComparisons)
+{
+    auto       parser = createParser("print(a * 2 < b + 1)");
+    LexerToken token;
+    parser->advanceToken(token);
+    auto            node      = parser->parseStatement(token);
+    const TreeNode& printNode = static_cast<const TreeNode&>(*node);
+
+    const BinaryNode& less = static_cast<const BinaryNode&>(*printNode.children[0]);
+    EXPECT_EQ(less.token.type, LexerTokenType::LessToken);
+    EXPECT_EQ(less.left->token.type, LexerTokenType::MultiplyToken);
+    EXPECT_EQ(less.right->token.type, LexerTokenType::PlusToken);
+}
+
+TEST_F(ParserTest, AssignmentInsidePrintIsRejected)
+{
+    for (auto source : {"print(x = 1)", "print(y + x = 1)"})
+    {
+        auto       parser = createParser(source);
+        LexerToken token;
+        parser->advanceToken(token);
+        try
+        {
+            parser->parseStatement(token);
+            ADD_FAILURE() << source;
+        }
+        catch (const Error& e)
+        {
+            EXPECT_EQ(e.getMessage(), "Assignment is not allowed within print statement");
+        }
+    }
+}
+
+TEST_F(ParserTest, ConditionAllowsSingleComparison)
+{
+    auto       parser = createParser("if (a < b < c) {\n}\n");
+    LexerToken token{"Program", noSourceOffset, LexerTokenType::ProgramToken};
+    parser->advanceToken(token);
+    try
+    {
+        parser->parseStatement(token);
+        ADD_FAILURE();
+    }
+    catch (const Error& e)
+    {
+        EXPECT_EQ(e.getMessage(), "Expected closing Braces");
+    }
+}
+
+TEST_F(ParserTest, LongChainsParseIteratively)
+{
+    // Left-associative chains are folded in a loop, so the parser's depth does not grow with their length
+    std::string source = "x = 1";
+    for (int i = 0; i < 200000; ++i)
+        source += i % 2 ? " * 3" : " + 2";
+
+    auto       parser = createParser(source);
+    LexerToken token;
+    parser->advanceToken(token);
+    auto node = parser->parseStatement(token);
+    EXPECT_EQ(token.type, LexerTokenType::Eof);
+
+    const auto* sum   = static_cast<const BinaryNode&>(*node).right;
+    size_t      terms = 1;
+    while (sum->token.type == LexerTokenType::PlusToken)
+    {
+        EXPECT_EQ(static_cast<const BinaryNode*>(sum)->right->token.type, LexerTokenType::MultiplyToken);
+        sum = static_cast<const BinaryNode*>(sum)->left;
+        ++terms;
+    }
+    EXPECT_EQ(terms, 100001u);
+}
+
+TEST_F(ParserTest, NestingBeyondTheLimitIsASyntaxError)
+{
+    auto parse = [this](const std::string& source, size_t maxNesting)
+    {
+        Parser     parser(source, output, arena, maxNesting);
+        LexerToken token{"Program", noSourceOffset, LexerTokenType::ProgramToken};
+        parser.advanceToken(token);
+        return parser.parseStatement(token);
+    };
+
+    EXPECT_NO_THROW(parse("x = ((1))", 2));
+    EXPECT_NO_THROW(parse("if (x > 1) {\nif (x > 2) {\ny = 1\n}\n}", 2));
+
+    for (const std::string source : {"x = (((1)))", "if (x > 1) {\nif (x > 2) {\ny = (1)\n}\n}"})
+    {
+        try
+        {
+            parse(source, 2);
+            FAIL() << source;
+        }
+        catch (const Error& e)
+        {
+            EXPECT_EQ(e.getType(), ErrorType::SYNTAX);
+            EXPECT_NE(e.getMessage().find("Nesting is too deep"), std::string::npos);
+        }
+    }
+
+    // Far deeper than the call stack could take, yet rejected cleanly under the default limit
+    EXPECT_THROW(parse("x = " + std::string(1000000, '(') + "1", defaultMaxNestingDepth), Error);
+}
+
+TEST_F(ParserTest, TryParseStatementReturnsErrors)
+{
+    auto tryParse = [this](const std::string& source)
+    {
+        Parser     parser(source, output, arena);
+        LexerToken token{"Program", noSourceOffset, LexerTokenType::ProgramToken};
+        parser.advanceToken(token);
+        return parser.tryParseStatement(token);
+    };
+
+    auto node = tryParse("x = 1 + 2");
+    ASSERT_TRUE(node.has_value());
+    EXPECT_EQ((*node)->token.type, LexerTokenType::AssignToken);
+
+    auto syntax = tryParse("x = 1 +");
+    ASSERT_FALSE(syntax.has_value());
+    EXPECT_EQ(syntax.error().getType(), ErrorType::SYNTAX);
+
+    // Lexical errors surface through the parser with their own type
+    auto lexical = tryParse("x = 1 + @");
+    ASSERT_FALSE(lexical.has_value());
+    EXPECT_EQ(lexical.error().getType(), ErrorType::LEXICAL);
+}
+
+TEST_F(ParserTest, BinaryASTRoundTrips)
+{
+    const std::string source = "a = 1 + 2 * 3\nif (a > 4) {\n    print(a)\n} else {\n    b = \"text\"\n}\nprint(a)\n";
+    auto              parser = createParser(source);
+    FlatAST           ast(parser->tokens());
+    std::vector<FlatAST::NodeId> statements;
+    LexerToken                   token;
+    parser->advanceToken(token);
+    while (token.type != LexerTokenType::Eof)
+    {
+        statements.push_back(ast.append(*parser->parseStatement(token)));
+        parser->advancePastNewlines(token);
+    }
+    const auto root  = ast.addBlock({"Program", noSourceOffset, LexerTokenType::ProgramToken}, statements);
+    const auto bytes = parser->binaryAST(ast, root);
+
+    auto reader = BinaryASTReader::open(bytes);
+    ASSERT_TRUE(reader.has_value()) << reader.error();
+    ASSERT_EQ(reader->size(), ast.size());
+    EXPECT_EQ(reader->root(), root);
+    for (FlatAST::NodeId id = 0; id <= root; ++id)
+    {
+        const auto token = ast.token(id);
+        EXPECT_EQ(reader->kind(id), ast.kind(id));
+        EXPECT_EQ(reader->tokenType(id), token.type);
+        EXPECT_EQ(reader->value(id), token.value);
+        EXPECT_EQ(reader->location(id).toString(), parser->locate(token.offset).toString());
+        const auto children = ast.children(id);
+        const auto slots    = reader->children(id);
+        EXPECT_EQ(std::vector<FlatAST::NodeId>(slots.begin(), slots.end()),
+                  std::vector<FlatAST::NodeId>(children.begin(), children.end()));
+    }
+    // Values point into the encoded bytes rather than into copies
+    EXPECT_GE(reader->value(0).data(), bytes.data());
+    EXPECT_LT(reader->value(0).data(), bytes.data() + bytes.size());
+
+    EXPECT_FALSE(BinaryASTReader::open("").has_value());
+    EXPECT_FALSE(BinaryASTReader::open("JSON" + bytes.substr(4)).has_value());
+    EXPECT_FALSE(BinaryASTReader::open(bytes.substr(0, bytes.size() - 1)).has_value());
+    EXPECT_FALSE(BinaryASTReader::open(bytes + '\0').has_value());
+    std::string newer = bytes;
+    newer[4]          = 2;
+    EXPECT_FALSE(BinaryASTReader::open(newer).has_value());
+}
+
+TEST_F(ParserTest, SharedSubtreesHashEqually)
+{
+    const std::string source = "x = a * b + a * b\nif (a > 1) {\n    y = a * b\n    a = 2\n    z = a * b\n}\n";
+    Parser            parser(source, output, arena, defaultMaxNestingDepth, nullptr, true);
+    LexerToken        token;
+    parser.shareNodes(false);
+    parser.advanceToken(token);
+
+    // Equal subtrees hash equally; without shared nodes each occurrence is a node at its own position
+    const auto& first = static_cast<const BinaryNode&>(*parser.parseStatement(token));
+    const auto& sum   = static_cast<const BinaryNode&>(*first.right);
+    const auto& left  = static_cast<const BinaryNode&>(*sum.left);
+    const auto& right = static_cast<const BinaryNode&>(*sum.right);
+    EXPECT_NE(&left, &right);
+    EXPECT_NE(left.hash, 0u);
+    EXPECT_EQ(left.hash, right.hash);
+    EXPECT_LT(left.left->token.offset, right.left->token.offset);
+    EXPECT_EQ(first.hash, 0u);
+
+    // Within the block, `a * b` hashes the same until `a` is assigned
+    parser.advancePastNewlines(token);
+    const auto& block  = *static_cast<const ConditionalNode&>(*parser.parseStatement(token)).ifNode;
+    const auto  before = static_cast<const BinaryNode&>(*block.children[0]).right;
+    const auto  after  = static_cast<const BinaryNode&>(*block.children[2]).right;
+    EXPECT_EQ(static_cast<const BinaryNode*>(before)->hash, left.hash);
+    EXPECT_NE(static_cast<const BinaryNode*>(after)->hash, static_cast<const BinaryNode*>(before)->hash);
+
+    // Hashes only depend on the input
+    Arena  other;
+    Parser again(source, output, other, defaultMaxNestingDepth, nullptr, true);
+    again.advanceToken(token);
+    const auto& repeated = static_cast<const BinaryNode&>(*again.parseStatement(token));
+    EXPECT_EQ(static_cast<const BinaryNode&>(*repeated.right).hash, sum.hash);
+
+    // Interned variables count their assignments by SymbolId, and hash as they do by name
+    Arena           internedArena;
+    IdentifierTable identifiers;
+    Parser          interned(source, output, internedArena, defaultMaxNestingDepth, nullptr, true);
+    interned.useIdentifiers(identifiers);
+    interned.advanceToken(token);
+    interned.parseStatement(token);
+    interned.advancePastNewlines(token);
+    const auto& internedBlock = *static_cast<const ConditionalNode&>(*interned.parseStatement(token)).ifNode;
+    const auto  internedAfter = static_cast<const BinaryNode&>(*internedBlock.children[2]).right;
+    EXPECT_EQ(static_cast<const BinaryNode*>(internedAfter)->hash, static_cast<const BinaryNode*>(after)->hash);
+
+    // A FlatAST stores `a * b` once, yet hands out the tokens of both occurrences
+    FlatAST                 shared(parser.tokens(), true);
+    const auto              root = shared.append(first);
+    std::vector<LexerToken> tokens;
+    shared.forEachOccurrence(root, [&](FlatAST::NodeId, const LexerToken& token) { tokens.push_back(token); });
+    EXPECT_EQ(shared.size(), 6u);
+    ASSERT_EQ(tokens.size(), 9u);
+    EXPECT_EQ(shared.occurrences(root), tokens.size());
+    EXPECT_EQ(tokens[1].offset, left.left->token.offset);
+    EXPECT_EQ(tokens[4].offset, right.left->token.offset);
+
+    // Without sharing no node is hashed
+    auto        plain      = createParser(source);
+    LexerToken  plainToken;
+    plain->advanceToken(plainToken);
+    const auto& unshared    = static_cast<const BinaryNode&>(*plain->parseStatement(plainToken));
+    const auto& unsharedSum = static_cast<const BinaryNode&>(*unshared.right);
+    EXPECT_EQ(unsharedSum.hash, 0u);
+}
+
+TEST_F(ParserTest, SharedSubtreesAreBuiltOnce)
+{
+    const std::string source = "x = (a * b + 1) * (a * b + 1)\ny = a * b + 1\n";
+    auto              parseAll = [&](Parser& parser)
+    {
+        std::vector<const BinaryNode*> statements;
+        LexerToken                     token;
+        parser.advanceToken(token);
+        while (token.type != LexerTokenType::Eof)
+        {
+            statements.push_back(static_cast<const BinaryNode*>(parser.parseStatement(token)));
+            parser.advancePastNewlines(token);
+        }
+        return statements;
+    };
+
+    Arena      plainArena;
+    Parser     plain(source, output, plainArena);
+    const auto plainStatements = parseAll(plain);
+    EXPECT_EQ(plainArena.objectCount(), 20u);
+
+    // `a * b + 1` is one node, here and in the next statement, and keeps its first occurrence's token
+    Parser      shared(source, output, arena, defaultMaxNestingDepth, nullptr, true);
+    const auto  start      = shared.position();
+    const auto  statements = parseAll(shared);
+    const auto& product    = static_cast<const BinaryNode&>(*statements[0]->right);
+    EXPECT_EQ(product.left, product.right);
+    EXPECT_EQ(statements[1]->right, product.left);
+    EXPECT_EQ(product.left->token.offset, static_cast<const BinaryNode&>(*plainStatements[0]->right).left->token.offset);
+    EXPECT_EQ(arena.objectCount(), 10u);
+
+    // Nodes are only shared within one use of an arena; after a reset they are made again
+    arena.reset();
+    shared.rewind(start);
+    const auto repeated = parseAll(shared);
+    EXPECT_EQ(arena.objectCount(), 10u);
+    EXPECT_EQ(static_cast<const BinaryNode*>(repeated[1]->right)->hash,
+              static_cast<const BinaryNode*>(product.left)->hash);
 }
\ No newline at end of file
@@ -8,24 +8,27 @@
 class SemanticTest : public ::testing::Test
 {
   protected:
-    CompilerOutput output;
-    Semantic       semantic{output};
+    CompilerOutput    output;
+    ScopedSymbolTable symbols;
+    Semantic          semantic{output, symbols};
+    Arena             arena;
+    ASTNodeFactory    factory{arena};
 
-    std::unique_ptr<BinaryNode> createLeafNode(std::string_view value, LexerTokenType type)
+    BinaryNode* createLeafNode(std::string_view value, LexerTokenType type)
     {
-        return ASTNodeFactory::createBinaryNode(nullptr, nullptr, LexerToken{value, {0, 0}, type});
+        return factory.createBinaryNode(nullptr, nullptr, LexerToken{value, 0, type});
     }
 
     // Helper to create a token
-    LexerToken createToken(std::string_view value, LexerTokenType type) { return LexerToken{value, {0, 0}, type}; }
+    LexerToken createToken(std::string_view value, LexerTokenType type) { return LexerToken{value, 0, type}; }
 
     // Helper for binary operations
-    std::unique_ptr<BinaryNode> createBinaryOperation(std::unique_ptr<BinaryNode> left,
-                                                      std::unique_ptr<BinaryNode> right,
+    BinaryNode* createBinaryOperation(BinaryNode* left,
+                                                      BinaryNode* right,
                                                       LexerTokenType              opType,
                                                       std::string_view            opValue)
     {
-        return ASTNodeFactory::createBinaryNode(std::move(left), std::move(right), LexerToken{opValue, {0, 0}, opType});
+        return factory.createBinaryNode(left, right, LexerToken{opValue, 0, opType});
     }
 };
 
@@ -33,17 +36,19 @@ TEST_F(SemanticTest, ValidAssignment)
 {
     auto left  = createLeafNode("x", LexerTokenType::VarToken);
     auto right = createLeafNode("42", LexerTokenType::IntToken);
-    auto node  = ASTNodeFactory::createBinaryNode(
-        std::move(left), std::move(right), createToken("=", LexerTokenType::AssignToken));
+    auto node  = factory.createBinaryNode(
+        left, right, createToken("=", LexerTokenType::AssignToken));
 
     EXPECT_NO_THROW(semantic.analyzeTree(*node));
 }
 
 TEST_F(SemanticTest, ValidArithmetic)
 {
+    // Each test has its own symbol table, so `x` is declared here rather than by an earlier test
+    symbols.insert("x", InferredType::INTEGER, createToken("x", LexerTokenType::VarToken));
     auto left  = createLeafNode("x", LexerTokenType::VarToken);
     auto right = createLeafNode("5", LexerTokenType::IntToken);
-    auto node  = createBinaryOperation(std::move(left), std::move(right), LexerTokenType::PlusToken, "+");
+    auto node  = createBinaryOperation(left, right, LexerTokenType::PlusToken, "+");
 
     EXPECT_NO_THROW(semantic.analyzeTree(*node));
 }
@@ -52,41 +57,130 @@ TEST_F(SemanticTest, TypeMismatch)
 {
     auto left  = createLeafNode("hello", LexerTokenType::StringToken);
     auto right = createLeafNode("42", LexerTokenType::IntToken);
-    auto node  = createBinaryOperation(std::move(left), std::move(right), LexerTokenType::PlusToken, "+");
+    auto node  = createBinaryOperation(left, right, LexerTokenType::PlusToken, "+");
 
     EXPECT_THROW(semantic.analyzeTree(*node), Error);
 }
 
+TEST_F(SemanticTest, AnalyzeReturnsErrors)
+{
+    auto mismatch = createBinaryOperation(createLeafNode("hello", LexerTokenType::StringToken),
+                                          createLeafNode("42", LexerTokenType::IntToken),
+                                          LexerTokenType::PlusToken,
+                                          "+");
+    auto result = semantic.analyze(*mismatch);
+    ASSERT_FALSE(result.has_value());
+    EXPECT_EQ(result.error().getType(), ErrorType::SEMANTIC);
+
+    auto assignment = createBinaryOperation(createLeafNode("x", LexerTokenType::VarToken),
+                                            createLeafNode("2", LexerTokenType::IntToken),
+                                            LexerTokenType::AssignToken,
+                                            "=");
+    EXPECT_TRUE(semantic.analyze(*assignment).has_value());
+}
+
 TEST_F(SemanticTest, ValidComparison)
 {
+    symbols.insert("x", InferredType::INTEGER, createToken("x", LexerTokenType::VarToken));
     auto left  = createLeafNode("x", LexerTokenType::VarToken);
     auto right = createLeafNode("5", LexerTokenType::IntToken);
-    auto node  = createBinaryOperation(std::move(left), std::move(right), LexerTokenType::GreaterToken, ">");
+    auto node  = createBinaryOperation(left, right, LexerTokenType::GreaterToken, ">");
 
     EXPECT_NO_THROW(semantic.analyzeTree(*node));
 }
 
 TEST_F(SemanticTest, ValidIfCondition)
 {
+    symbols.insert("x", InferredType::INTEGER, createToken("x", LexerTokenType::VarToken));
     // Create condition: x > 5
     auto condLeft  = createLeafNode("x", LexerTokenType::VarToken);
     auto condRight = createLeafNode("5", LexerTokenType::IntToken);
     auto condition =
-        createBinaryOperation(std::move(condLeft), std::move(condRight), LexerTokenType::GreaterToken, ">");
+        createBinaryOperation(condLeft, condRight, LexerTokenType::GreaterToken, ">");
 
     // Create then branch: y = 1
-    std::vector<std::unique_ptr<ASTNode>> thenChildren;
+    std::vector<ASTNode*> thenChildren;
     auto                                  assignLeft  = createLeafNode("y", LexerTokenType::VarToken);
     auto                                  assignRight = createLeafNode("1", LexerTokenType::IntToken);
     auto                                  assignment =
-        createBinaryOperation(std::move(assignLeft), std::move(assignRight), LexerTokenType::AssignToken, "=");
-    thenChildren.push_back(std::move(assignment));
+        createBinaryOperation(assignLeft, assignRight, LexerTokenType::AssignToken, "=");
+    thenChildren.push_back(assignment);
 
     auto thenBranch =
-        ASTNodeFactory::createTreeNode(std::move(thenChildren), createToken("block", LexerTokenType::ProgramToken));
+        factory.createTreeNode(thenChildren, createToken("block", LexerTokenType::ProgramToken));
 
-    auto ifNode = ASTNodeFactory::createConditionalNode(
-        std::move(condition), std::move(thenBranch), nullptr, createToken("if", LexerTokenType::IfToken));
+    auto ifNode = factory.createConditionalNode(
+        condition, thenBranch, nullptr, createToken("if", LexerTokenType::IfToken));
 
     EXPECT_NO_THROW(semantic.analyzeTree(*ifNode));
 }
+
+
+TEST_F(SemanticTest, LongChainsAreAnalyzedIteratively)
+{
+    // deep = 1 + 1 + ... is a left spine as deep as the chain is long
+    BinaryNode* sum = createLeafNode("1", LexerTokenType::IntToken);
+    for (int i = 0; i < 200000; ++i)
+        sum = createBinaryOperation(sum, createLeafNode("1", LexerTokenType::IntToken), LexerTokenType::PlusToken, "+");
+
+    auto node = factory.createBinaryNode(
+        createLeafNode("deep", LexerTokenType::VarToken), sum, createToken("=", LexerTokenType::AssignToken));
+    EXPECT_NO_THROW(semantic.analyzeTree(*node));
+}
+
+TEST_F(SemanticTest, ScopesShadowAndRestore)
+{
+    const auto token = createToken("x", LexerTokenType::VarToken);
+    symbols.insert("x", InferredType::INTEGER, token);
+    symbols.insert("y", InferredType::BOOL, token);
+
+    symbols.enterScope();
+    EXPECT_FALSE(symbols.declaresAny());
+    symbols.insert("x", InferredType::FLOAT, token);
+    EXPECT_TRUE(symbols.declaresAny());
+    EXPECT_THROW(symbols.insert("x", InferredType::STRING, token), Error);
+    for (int depth = 0; depth < 1000; ++depth)
+        symbols.enterScope();
+    // Lookups see the innermost declaration however deep the scopes are
+    EXPECT_EQ(symbols.lookup("x"), InferredType::FLOAT);
+    EXPECT_EQ(symbols.lookup("y"), InferredType::BOOL);
+    EXPECT_FALSE(symbols.lookupCurrentScope("x").has_value());
+    symbols.insert("z", InferredType::STRING, token);
+    ASSERT_EQ(symbols.getSymbolTable().size(), 1002u);
+    EXPECT_EQ(symbols.getSymbolTable()[1].size(), 1u);
+    for (int depth = 0; depth < 1000; ++depth)
+        symbols.exitScope();
+    EXPECT_FALSE(symbols.contains("z"));
+    EXPECT_EQ(symbols.lookupCurrentScope("x"), InferredType::FLOAT);
+
+    EXPECT_TRUE(symbols.remove("x"));
+    EXPECT_EQ(symbols.lookup("x"), InferredType::INTEGER);
+    EXPECT_FALSE(symbols.remove("y")); // declared in an outer scope
+    symbols.exitScope();
+    EXPECT_EQ(symbols.lookup("x"), InferredType::INTEGER);
+    EXPECT_EQ(symbols.getCurrentScopeLevel(), 0);
+}
+
+TEST_F(SemanticTest, ExpressionsAreAnnotatedWithTheirTypes)
+{
+    symbols.insert("f", InferredType::FLOAT, createToken("f", LexerTokenType::VarToken));
+    // (f * 2.0) + (1.5 * 2.0) < 3.0
+    auto product  = createBinaryOperation(
+        createLeafNode("f", LexerTokenType::VarToken), createLeafNode("2.0", LexerTokenType::FloatToken),
+        LexerTokenType::MultiplyToken, "*");
+    auto constant = createBinaryOperation(
+        createLeafNode("1.5", LexerTokenType::FloatToken), createLeafNode("2.0", LexerTokenType::FloatToken),
+        LexerTokenType::MultiplyToken, "*");
+    auto sum      = createBinaryOperation(product, constant, LexerTokenType::PlusToken, "+");
+    auto compare  = createBinaryOperation(
+        sum, createLeafNode("3.0", LexerTokenType::FloatToken), LexerTokenType::LessToken, "<");
+    EXPECT_FALSE(compare->type.has_value());
+
+    ASSERT_TRUE(semantic.analyze(*compare));
+    for (const BinaryNode* node : {compare, sum, product, constant})
+        EXPECT_EQ(node->type, InferredType::FLOAT);
+    EXPECT_EQ(static_cast<const BinaryNode*>(product->left)->type, InferredType::FLOAT);
+    EXPECT_TRUE(compare->readsVariable);
+    EXPECT_TRUE(sum->readsVariable);
+    EXPECT_FALSE(constant->readsVariable);
+}